@@ -0,0 +1,74 @@
+#include "aot.hpp"
+
+AotMachine::AotMachine(const AotProgram& program)
+    : program(program), entries(0x1000, nullptr) {
+    compiledCycles = 0;
+
+    std::copy(program.rom, program.rom + program.romSize, memory + RomImage::LOAD_ADDRESS);
+    blockCache.clear();
+    attachBlocks();
+}
+
+const AotProgram& AotMachine::getProgram() const {
+    return program;
+}
+
+unsigned long long AotMachine::getCompiledCycles() const {
+    return compiledCycles;
+}
+
+bool AotMachine::loadROM(const RomImage& rom) {
+    if (!Chip8Core::loadROM(rom)) {
+        return false;
+    }
+
+    attachBlocks();
+    return true;
+}
+
+bool AotMachine::loadState(const uint8_t* state, std::size_t size) {
+    if (!Chip8Core::loadState(state, size)) {
+        return false;
+    }
+
+    attachBlocks();
+    return true;
+}
+
+void AotMachine::attachBlocks() {
+    std::fill(entries.begin(), entries.end(), nullptr);
+
+    for (std::size_t i = 0; i < program.blockCount; ++i) {
+        const AotBlock& block = program.blocks[i];
+        unsigned int offset = block.start - RomImage::LOAD_ADDRESS;
+
+        if (!std::equal(memory + block.start, memory + block.start + 2 * block.length, program.rom + offset)) {
+            continue;
+        }
+
+        // The cached copy is never run; it is there so writes to the block mark it invalidated
+        blockCache.lookup(block.start, memory);
+        entries[block.start] = &block;
+    }
+}
+
+void AotMachine::run(unsigned long long cycles) {
+    // Traces and profiles count every instruction, so they need the interpreter
+    if (PROFILING || tracer) {
+        Chip8Core::run(cycles);
+        return;
+    }
+
+    while (cycles > 0) {
+        const AotBlock* block = pc < entries.size() ? entries[pc] : nullptr;
+
+        if (block && block->length <= cycles && !blockCache.wasInvalidated(pc)) {
+            block->function(*this);
+            cycles -= block->length;
+            compiledCycles += block->length;
+        } else {
+            cycle();
+            cycles--;
+        }
+    }
+}
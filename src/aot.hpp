@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "chip8.hpp"
+
+class AotMachine;
+
+// A basic block emu_aot compiled to C++. It starts with pc at start, runs
+// length instructions and leaves pc where the interpreter would.
+struct AotBlock {
+    uint16_t start;
+    uint16_t length;                        // Instructions
+    void (*function)(AotMachine& m);
+};
+
+// Everything emu_aot generates for one ROM. Blocks only cover the ROM's own
+// bytes and are cut exactly where the block cache cuts them.
+struct AotProgram {
+    const char* name;                       // File the ROM was compiled from
+    uint64_t romHash;
+    const uint8_t* rom;
+    std::size_t romSize;
+    const AotBlock* blocks;
+    std::size_t blockCount;
+};
+
+// Defined by the translation unit emu_aot writes
+extern const AotProgram aotProgram;
+
+// The 4 KB core without quirks, running a ROM compiled ahead of time. run()
+// calls the compiled function for the block at pc, and interprets wherever
+// there is none: after a computed jump, in code reached only through one, in
+// memory outside the ROM, and in blocks cut short by the cycle count. A
+// block rewritten since loading is never run compiled again; the block cache
+// tracks the writes, as it does for the JIT.
+class AotMachine final : public Chip8Core<0x1000> {
+    public:
+        explicit AotMachine(const AotProgram& program);
+
+        const AotProgram& getProgram() const;
+        unsigned long long getCompiledCycles() const;       // Instructions run in compiled blocks
+
+        using Chip8::loadROM;
+        bool loadROM(const RomImage& rom) override;
+        void run(unsigned long long cycles) override;
+        bool loadState(const uint8_t* state, std::size_t size) override;
+
+    private:
+        // Generated block functions reach the machine state through this
+        friend struct AotBlocks;
+
+        const AotProgram& program;
+        std::vector<const AotBlock*> entries;              // Compiled block at each address, if current
+        unsigned long long compiledCycles;
+
+        // Enables the blocks whose bytes in memory are still the ones they
+        // were compiled from, and has the block cache watch them for writes
+        void attachBlocks();
+};
@@ -0,0 +1,288 @@
+#include "chip8.hpp"
+#include "romimage.hpp"
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+namespace {
+    // Finds every block reachable from the entry point by following jumps,
+    // calls, returns to the instruction after a call and both sides of every
+    // skip. Blocks are cut by the block cache, so each one is exactly the
+    // block the interpreter would cache at its start. Targets outside the ROM,
+    // blocks running past its end and code reached only through BNNN are left
+    // to the interpreter.
+    class Discovery {
+        public:
+            Discovery(const uint8_t* memory, unsigned int romEnd)
+                : memory(memory), romEnd(romEnd) {
+            }
+
+            void discover(unsigned int address) {
+                if (address < RomImage::LOAD_ADDRESS || address >= romEnd || blocks.count(address)) {
+                    return;
+                }
+
+                const Block* block = cache.lookup(address, memory);
+
+                if (!block || block->end > romEnd) {
+                    return;
+                }
+
+                blocks[address] = block;
+
+                const Instruction& last = block->instrs.back();
+
+                if (!Chip8::endsBlock(last.op)) {
+                    discover(block->end);
+                    return;
+                }
+
+                switch (last.op) {
+                    case Chip8::OP_0NNN: case Chip8::OP_1NNN:
+                        discover(last.nnn);
+                        break;
+                    case Chip8::OP_2NNN:
+                        discover(last.nnn);
+                        discover(block->end);
+                        break;
+                    case Chip8::OP_3XNN: case Chip8::OP_4XNN: case Chip8::OP_5XY0:
+                    case Chip8::OP_9XY0: case Chip8::OP_EX9E: case Chip8::OP_EXA1:
+                        discover(block->end);
+                        discover(block->end + 2);
+                        break;
+                    // Returns go back to the instruction after a call, found with
+                    // the call. BNNN jumps somewhere only known at run time, and
+                    // the rest trap in the 4 KB core.
+                    case Chip8::OP_00EE: case Chip8::OP_BNNN: case Chip8::OP_INVALID:
+                    case Chip8::OP_5XY2: case Chip8::OP_5XY3: case Chip8::OP_F000:
+                    case Chip8::OP_FN01: case Chip8::OP_F002: case Chip8::OP_FX3A:
+                        break;
+                    default:
+                        discover(block->end);
+                        break;
+                }
+            }
+
+            const std::map<uint16_t, const Block*>& getBlocks() const {
+                return blocks;
+            }
+
+        private:
+            const uint8_t* memory;
+            unsigned int romEnd;
+            BlockCache cache;
+            std::map<uint16_t, const Block*> blocks;
+    };
+
+    std::string hex(unsigned int value, int width) {
+        std::ostringstream text;
+        text << "0x" << std::hex << std::uppercase << std::setw(width) << std::setfill('0') << value;
+        return text.str();
+    }
+
+    std::string reg(unsigned int x) {
+        return "V[" + std::to_string(x) + "]";
+    }
+
+    std::string skip(const std::string& condition, unsigned int next) {
+        return "m.pc = " + condition + " ? " + hex(next + 2, 3) + " : " + hex(next, 3) + ";";
+    }
+
+    // C++ for one instruction of a block. Simple instructions are written out
+    // in place, statement for statement as their handlers run them; the rest
+    // call the handler. Only the last instruction of a block moves pc, so
+    // handlers that look at pc get it set first.
+    std::string translate(const Instruction& instr, unsigned int next, bool last) {
+        std::string x = reg(instr.x);
+        std::string y = reg(instr.y);
+
+        switch (instr.op) {
+            case Chip8::OP_0NNN: case Chip8::OP_1NNN:
+                return "m.pc = " + hex(instr.nnn, 3) + ";";
+            case Chip8::OP_3XNN:
+                return skip(x + " == " + hex(instr.nn, 2), next);
+            case Chip8::OP_4XNN:
+                return skip(x + " != " + hex(instr.nn, 2), next);
+            case Chip8::OP_5XY0:
+                return skip(x + " == " + y, next);
+            case Chip8::OP_9XY0:
+                return skip(x + " != " + y, next);
+            case Chip8::OP_EX9E:
+                return skip("(m.keys & (1 << (" + x + " & 0xF)))", next);
+            case Chip8::OP_EXA1:
+                return skip("!(m.keys & (1 << (" + x + " & 0xF)))", next);
+            case Chip8::OP_6XNN:
+                return x + " = " + hex(instr.nn, 2) + ";";
+            case Chip8::OP_7XNN:
+                return x + " += " + hex(instr.nn, 2) + ";";
+            case Chip8::OP_8XY0:
+                return x + " = " + y + ";";
+            case Chip8::OP_8XY1:
+                return x + " |= " + y + ";";
+            case Chip8::OP_8XY2:
+                return x + " &= " + y + ";";
+            case Chip8::OP_8XY3:
+                return x + " ^= " + y + ";";
+            case Chip8::OP_8XY4:
+                return "V[15] = " + x + " + " + y + " > 255; " + x + " += " + y + ";";
+            case Chip8::OP_8XY5:
+                return "V[15] = " + x + " > " + y + "; " + x + " -= " + y + ";";
+            case Chip8::OP_8XY6:
+                return "V[15] = " + x + " & 1; " + x + " >>= 1;";
+            case Chip8::OP_8XY7:
+                return "V[15] = " + y + " > " + x + "; " + x + " = " + y + " - " + x + ";";
+            case Chip8::OP_8XYE:
+                return "V[15] = " + x + " >> 7; " + x + " <<= 1;";
+            case Chip8::OP_ANNN:
+                return "m.indexReg = " + hex(instr.nnn, 3) + ";";
+            case Chip8::OP_BNNN:
+                return "m.pc = V[0] + " + hex(instr.nnn, 3) + ";";
+            case Chip8::OP_CXNN:
+                return x + " = m.rng.next() & " + hex(instr.nn, 2) + ";";
+            case Chip8::OP_FX07:
+                return x + " = m.delayTimer;";
+            case Chip8::OP_FX15:
+                return "m.delayTimer = " + x + ";";
+            case Chip8::OP_FX18:
+                return "m.soundTimer = " + x + ";";
+            case Chip8::OP_FX1E:
+                return "m.indexReg += " + x + ";";
+            case Chip8::OP_FX29:
+                return "m.indexReg = 0x50 + 5 * " + x + ";";
+        }
+
+        std::ostringstream call;
+
+        if (last) {
+            call << "m.pc = " << hex(next, 3) << "; ";
+        }
+
+        call << "m.op_" << Chip8::opName(instr.op) << "(Instruction{ Chip8::OP_" << Chip8::opName(instr.op) << ", "
+             << unsigned(instr.x) << ", " << unsigned(instr.y) << ", " << unsigned(instr.n) << ", "
+             << hex(instr.nn, 2) << ", " << hex(instr.nnn, 3) << " });";
+        return call.str();
+    }
+
+    std::string quoted(const std::string& text) {
+        std::string result = "\"";
+
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+            }
+
+            result += c;
+        }
+
+        return result + '"';
+    }
+
+    void writeProgram(std::ostream& out, const std::string& name, const RomImage& rom,
+                      const std::map<uint16_t, const Block*>& blocks) {
+        out << "// Generated by emu_aot from " << name << ". Do not edit.\n";
+        out << "#include \"aot.hpp\"\n\n";
+        out << "struct AotBlocks {\n";
+
+        for (const auto& entry : blocks) {
+            const Block* block = entry.second;
+            unsigned int address = block->start;
+
+            std::ostringstream body;
+
+            for (std::size_t i = 0; i < block->instrs.size(); ++i) {
+                const Instruction& instr = block->instrs[i];
+                bool last = i + 1 == block->instrs.size();
+
+                body << "        " << translate(instr, address + 2, last)
+                     << "    // " << hex(address, 3).substr(2) << ' ' << Chip8::opName(instr.op) << '\n';
+                address += 2;
+            }
+
+            if (!Chip8::endsBlock(block->instrs.back().op)) {
+                body << "        m.pc = " << hex(block->end, 3) << ";\n";
+            }
+
+            out << "    static void block" << hex(block->start, 3).substr(2) << "(AotMachine& m) {\n";
+
+            if (body.str().find("V[") != std::string::npos) {
+                out << "        uint8_t* V = m.registers;\n";
+            }
+
+            out << body.str() << "    }\n";
+        }
+
+        out << "};\n\n";
+        out << "namespace {\n";
+        out << "    const uint8_t rom[] = {";
+
+        for (std::size_t i = 0; i < rom.size(); ++i) {
+            out << (i % 16 == 0 ? "\n        " : " ") << hex(rom.data()[i], 2) << ',';
+        }
+
+        out << "\n    };\n\n";
+        out << "    const AotBlock blocks[] = {\n";
+
+        for (const auto& entry : blocks) {
+            const Block* block = entry.second;
+            std::string start = hex(block->start, 3);
+
+            out << "        { " << start << ", " << block->instrs.size() << ", AotBlocks::block" << start.substr(2) << " },\n";
+        }
+
+        out << "    };\n";
+        out << "}\n\n";
+        out << "const AotProgram aotProgram = {\n";
+        out << "    " << quoted(name) << ", " << "0x" << std::hex << rom.getHash() << std::dec << "ull,\n";
+        out << "    rom, sizeof(rom), blocks, sizeof(blocks) / sizeof(blocks[0])\n";
+        out << "};\n";
+    }
+}
+
+// Compiles a ROM for the 4 KB core without quirks into a C++ translation
+// unit defining aotProgram, one function per basic block, for linking into
+// an AOT runner. See chip8_add_aot_runner() in CMakeLists.txt.
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cout << "Usage: " << argv[0] << " <path to rom> <output.cpp>\n";
+        std::exit(0);
+    }
+
+    RomImage::Status status;
+    std::shared_ptr<const RomImage> rom = RomImage::open(argv[1], 0x1000, &status);
+
+    if (!rom) {
+        std::cout << (status == RomImage::Status::TooLarge ? "ROM too large for memory: " : "Could not open ROM: ") << argv[1] << '\n';
+        std::exit(1);
+    }
+
+    std::vector<uint8_t> memory(0x1000, 0);
+    std::copy(rom->data(), rom->data() + rom->size(), memory.begin() + RomImage::LOAD_ADDRESS);
+
+    Discovery discovery(memory.data(), RomImage::LOAD_ADDRESS + rom->size());
+    discovery.discover(RomImage::LOAD_ADDRESS);
+
+    std::string name = argv[1];
+    std::size_t slash = name.find_last_of("/\\");
+
+    if (slash != std::string::npos) {
+        name = name.substr(slash + 1);
+    }
+
+    std::ofstream out(argv[2]);
+    writeProgram(out, name, *rom, discovery.getBlocks());
+    out.close();
+
+    if (!out) {
+        std::cout << "Could not write " << argv[2] << '\n';
+        std::exit(1);
+    }
+
+    unsigned long long instructions = 0;
+
+    for (const auto& entry : discovery.getBlocks()) {
+        instructions += entry.second->instrs.size();
+    }
+
+    std::cout << "Blocks:   " << discovery.getBlocks().size() << ", " << instructions << " instructions\n";
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "aot.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    // Runs the compiled machine against the table interpreter, which starts
+    // from a snapshot of it so both have the same ROM and seed. Cycles are fed
+    // in uneven batches so blocks get cut short at batch boundaries too.
+    // Halfway through, the compiled machine is restored from the interpreter,
+    // so blocks have to be reattached to whatever memory the snapshot holds.
+    bool verify(unsigned long long cycles) {
+        AotMachine machine(aotProgram);
+        std::unique_ptr<Chip8> reference = Chip8::create();
+        machine.seed(cycles);
+        reference->setIdleSkip(false);
+
+        std::vector<uint8_t> state = machine.saveState();
+        reference->loadState(state.data(), state.size());
+
+        unsigned long long done = 0;
+        unsigned long long batch = 1;
+
+        while (done < cycles) {
+            unsigned long long count = std::min(batch, cycles - done);
+            machine.run(count);
+            reference->run(count);
+            machine.tickTimers();
+            reference->tickTimers();
+            done += count;
+            batch = batch * 7 % 997 + 1;
+
+            if (done >= cycles / 2 && done - count < cycles / 2) {
+                state = reference->saveState();
+                machine.loadState(state.data(), state.size());
+            }
+        }
+
+        bool match = machine.sameState(*reference);
+        std::cout << aotProgram.name << ": aot" << (match ? " matches\n" : " MISMATCH\n");
+        return match;
+    }
+}
+
+// The runner emu_aot's output is linked into. Runs the compiled ROM headless
+// for a fixed number of cycles and reports throughput, like emu_bench. The
+// timers tick once every frameCycles cycles, standing in for 60 Hz.
+int main(int argc, char **argv) {
+    unsigned long long cycles = 10000000;
+    unsigned long long frameCycles = 10000;
+    bool verifyMode = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--frame") == 0 && i + 1 < argc) {
+            frameCycles = std::max(1ull, std::strtoull(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--verify") == 0) {
+            verifyMode = true;
+        } else if (std::strcmp(argv[i], "--help") == 0) {
+            std::cout << "Usage: " << argv[0] << " [--verify] [--frame N] [cycles]\n";
+            std::cout << "Runs " << aotProgram.name << ", compiled ahead of time\n";
+            std::exit(0);
+        } else {
+            cycles = std::strtoull(argv[i], nullptr, 10);
+        }
+    }
+
+    if (verifyMode) {
+        return verify(cycles) ? 0 : 1;
+    }
+
+    AotMachine machine(aotProgram);
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (unsigned long long done = 0; done < cycles; done += frameCycles) {
+        machine.run(std::min(frameCycles, cycles - done));
+        machine.tickTimers();
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+    if (machine.isTrapped()) {
+        std::cout << "Invalid opcode " << std::hex << std::setw(4) << std::setfill('0') << machine.getTrapOpcode()
+                  << " at " << std::setw(3) << machine.getTrapAddress() << std::dec << '\n';
+    }
+
+    std::cout << "ROM:      " << aotProgram.name << ", hash "
+              << std::hex << std::setw(16) << std::setfill('0') << aotProgram.romHash << std::dec << '\n';
+    std::cout << "Cycles:   " << cycles << '\n';
+    std::cout << "Seconds:  " << seconds << '\n';
+    std::cout << "IPS:      " << std::fixed << std::setprecision(0) << cycles / seconds << '\n';
+    std::cout << "Compiled: " << aotProgram.blockCount << " blocks, "
+              << std::setprecision(1) << 100.0 * machine.getCompiledCycles() / std::max(cycles, 1ull) << "% of cycles\n";
+    return 0;
+}
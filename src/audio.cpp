@@ -0,0 +1,66 @@
+#include "audio.hpp"
+#include <iostream>
+
+Audio::Audio() : channel(SAMPLE_RATE), device(0), spec(), driver("none") {
+    SDL_AudioSpec wanted{};
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        std::cout << "No audio: " << SDL_GetError() << '\n';
+        return;
+    }
+
+    wanted.freq = SAMPLE_RATE;
+    wanted.format = AUDIO_F32SYS;
+    wanted.channels = 1;
+    wanted.samples = BUFFER_SAMPLES;
+    wanted.callback = callback;
+    wanted.userdata = this;
+
+    // No allowed changes: SDL converts to whatever the hardware wants
+    device = SDL_OpenAudioDevice(nullptr, 0, &wanted, &spec, 0);
+
+    if (!device) {
+        std::cout << "No audio: " << SDL_GetError() << '\n';
+        return;
+    }
+
+    const char* name = SDL_GetCurrentAudioDriver();
+
+    if (name) {
+        driver = name;
+    }
+
+    SDL_PauseAudioDevice(device, 0);
+}
+
+Audio::~Audio() {
+    close();
+}
+
+bool Audio::isOpen() const {
+    return device != 0;
+}
+
+SoundChannel& Audio::getChannel() {
+    return channel;
+}
+
+void Audio::close() {
+    if (device) {
+        SDL_CloseAudioDevice(device);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        device = 0;
+    }
+}
+
+void Audio::writeReport(std::ostream& out) const {
+    out << "Audio:           " << driver << " driver, " << spec.freq << " Hz, "
+        << spec.samples << " sample buffer (" << 1000.0 * spec.samples / spec.freq << " ms)\n";
+    out << "Gate latency:    ";
+    channel.getGateLatency().writeSummary(out);
+}
+
+void Audio::callback(void* userdata, Uint8* stream, int length) {
+    Audio* audio = static_cast<Audio*>(userdata);
+    audio->channel.render(reinterpret_cast<float*>(stream), length / sizeof(float));
+}
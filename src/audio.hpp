@@ -0,0 +1,35 @@
+#pragma once
+
+#include <SDL.h>
+#include <ostream>
+#include <string>
+#include "sound.hpp"
+
+// Plays a SoundChannel on the default SDL audio device. SDL calls the
+// channel's render() on its own audio thread. Without a usable device, e.g.
+// no sound hardware, the emulator runs silently.
+class Audio {
+    public:
+        static const int SAMPLE_RATE = 48000;
+        static const int BUFFER_SAMPLES = 512;      // Per callback, about 11 ms
+
+        Audio();
+        ~Audio();
+
+        bool isOpen() const;
+        SoundChannel& getChannel();
+
+        // Stops the callback; call before SDL_Quit
+        void close();
+
+        // Driver, buffer size and the gate latency histogram. Only once closed.
+        void writeReport(std::ostream& out) const;
+
+    private:
+        SoundChannel channel;
+        SDL_AudioDeviceID device;
+        SDL_AudioSpec spec;
+        std::string driver;         // Captured on open, since SDL forgets it once audio shuts down
+
+        static void callback(void* userdata, Uint8* stream, int length);
+};
@@ -0,0 +1,277 @@
+#include "chip8.hpp"
+#include "quirks.hpp"
+#include "recording.hpp"
+#include "romcatalog.hpp"
+#include "scheduler.hpp"
+#include "threadpool.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+
+namespace {
+    struct Job {
+        std::string rom;
+        unsigned long long cycles;
+        std::string inputScript;
+        const RomCatalog::Entry* entry;     // Null when the ROM couldn't be catalogued
+        RomImage::Status romStatus;
+    };
+
+    struct Result {
+        unsigned long long cycles;
+        uint64_t hash;
+        double seconds;
+        QuirkProfile profile;
+        std::string status;
+    };
+
+    struct Options {
+        Chip8::Dispatch dispatch;
+        unsigned int instructionsPerSecond;
+        uint64_t seed;
+        bool idleSkip;
+        bool xoChip;
+        QuirkProfile profile;               // For ROMs the database doesn't list
+        QuirkDatabase quirkDatabase;
+    };
+
+    // Manifest lines are "<rom> <cycles> [input script]"; blank lines and # comments are skipped
+    bool readManifest(const char* filename, std::vector<Job>& jobs) {
+        std::ifstream file(filename);
+        std::string line;
+
+        if (!file.is_open()) {
+            return false;
+        }
+
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            Job job;
+
+            if (line.empty() || line[0] == '#' || !(fields >> job.rom >> job.cycles)) {
+                continue;
+            }
+
+            fields >> job.inputScript;
+            jobs.push_back(job);
+        }
+
+        return true;
+    }
+
+    // Input script lines are "<cycle> <key 0-F> <1 pressed | 0 released>"
+    bool readInputScript(const std::string& filename, std::vector<InputEvent>& events) {
+        std::ifstream file(filename);
+        std::string line;
+
+        if (!file.is_open()) {
+            return false;
+        }
+
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            InputEvent event;
+            unsigned int key;
+            unsigned int pressed;
+
+            if (line.empty() || line[0] == '#' || !(fields >> event.cycle >> std::hex >> key >> std::dec >> pressed)) {
+                continue;
+            }
+
+            event.key = key & 0xF;
+            event.pressed = pressed != 0;
+            events.push_back(event);
+        }
+
+        std::stable_sort(events.begin(), events.end(), [](const InputEvent& a, const InputEvent& b) {
+            return a.cycle < b.cycle;
+        });
+
+        return true;
+    }
+
+    Result runJob(const Job& job, const Options& options) {
+        Result result = { 0, 0, 0.0, job.entry ? job.entry->profile : options.profile, "ok" };
+        std::vector<InputEvent> events;
+
+        if (!job.entry) {
+            result.status = job.romStatus == RomImage::Status::TooLarge ? "rom-too-large" : "missing-rom";
+            return result;
+        }
+
+        std::unique_ptr<Chip8> chip8 = Chip8::create(options.xoChip, result.profile);
+
+        chip8->seed(options.seed);
+        chip8->setDispatch(options.dispatch);
+        chip8->setIdleSkip(options.idleSkip);
+        chip8->loadROM(*job.entry->image);
+
+        if (!job.inputScript.empty() && !readInputScript(job.inputScript, events)) {
+            result.status = "missing-input";
+            return result;
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+        result.cycles = replayInput(*chip8, options.instructionsPerSecond, events, job.cycles);
+        auto endTime = std::chrono::steady_clock::now();
+
+        result.hash = chip8->stateHash();
+        result.seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+        if (chip8->isTrapped()) {
+            result.status = "trapped";
+        }
+
+        return result;
+    }
+}
+
+// Runs every job of a manifest on its own headless Chip8 across a thread pool
+// and writes the final state hash and timing of each to a results file.
+int main(int argc, char **argv) {
+    Options options = { Chip8::Dispatch::Jit, Scheduler::DEFAULT_IPS, 0, true, false, QuirkProfile::Default, QuirkDatabase() };
+    const char* manifest = nullptr;
+    const char* output = "results.tsv";
+    const char* romDirectory = nullptr;
+    bool quirksGiven = false;
+    unsigned int threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--ips") == 0 && i + 1 < argc) {
+            const char* rate = argv[++i];
+            char* end;
+            unsigned long value = std::strtoul(rate, &end, 10);
+
+            // At 0 IPS no job would ever finish
+            if (end == rate || *end != '\0' || value == 0 || value > std::numeric_limits<unsigned int>::max()) {
+                std::cout << "Invalid instruction rate: " << rate << '\n';
+                std::exit(1);
+            }
+
+            options.instructionsPerSecond = value;
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--interpret") == 0) {
+            options.dispatch = Chip8::Dispatch::Table;
+        } else if (std::strcmp(argv[i], "--no-idle-skip") == 0) {
+            options.idleSkip = false;
+        } else if (std::strcmp(argv[i], "--xo") == 0) {
+            options.xoChip = true;
+        } else if (std::strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            if (!parseQuirkProfile(argv[++i], options.profile)) {
+                std::cout << "Unknown quirk profile: " << argv[i] << '\n';
+                std::exit(1);
+            }
+
+            quirksGiven = true;
+        } else if (std::strcmp(argv[i], "--quirk-db") == 0 && i + 1 < argc) {
+            if (!options.quirkDatabase.load(argv[++i])) {
+                std::cout << "Could not read quirk database: " << argv[i] << '\n';
+                std::exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--rom-dir") == 0 && i + 1 < argc) {
+            romDirectory = argv[++i];
+        } else {
+            manifest = argv[i];
+        }
+    }
+
+    if (!manifest) {
+        std::cout << "Usage: " << argv[0] << " [-o results.tsv] [-j threads] [--ips N] [--seed N] [--interpret] [--no-idle-skip] [--xo] [--quirks profile] [--quirk-db file] [--rom-dir dir] <manifest>\n";
+        std::exit(0);
+    }
+
+    // Without --quirks, XO-CHIP ROMs get the XO-CHIP quirks
+    if (!quirksGiven && options.xoChip) {
+        options.profile = QuirkProfile::XoChip;
+    }
+
+    std::vector<Job> jobs;
+
+    if (!readManifest(manifest, jobs)) {
+        std::cout << "Could not open manifest: " << manifest << '\n';
+        std::exit(1);
+    }
+
+    // Opened before any job runs, so a bad path doesn't throw away the batch
+    std::ofstream file(output);
+
+    if (!file) {
+        std::cout << "Could not write results: " << output << '\n';
+        std::exit(1);
+    }
+
+    // Every distinct ROM is read and validated once, up front, and its jobs share the image
+    RomCatalog catalog(options.xoChip ? 0x10000 : 0x1000, options.quirkDatabase, options.profile);
+
+    if (romDirectory && !catalog.scan(romDirectory)) {
+        std::cout << "Could not read ROM directory: " << romDirectory << '\n';
+        std::exit(1);
+    }
+
+    for (Job& job : jobs) {
+        job.entry = catalog.add(job.rom, &job.romStatus);
+
+        // A manifest may also name a catalogued ROM by its hash
+        uint64_t hash;
+        std::istringstream field(job.rom);
+
+        if (!job.entry && job.rom.size() == 16 && field >> std::hex >> hash && field.eof()) {
+            job.entry = catalog.find(hash);
+        }
+    }
+
+    std::vector<Result> results(jobs.size());
+    auto startTime = std::chrono::steady_clock::now();
+
+    {
+        ThreadPool pool(threads);
+        threads = pool.size();
+
+        for (std::size_t i = 0; i < jobs.size(); ++i) {
+            pool.submit([&jobs, &results, &options, i] {
+                results[i] = runJob(jobs[i], options);
+            });
+        }
+
+        pool.wait();
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(endTime - startTime).count();
+    unsigned long long totalCycles = 0;
+
+    file << "rom\tcycles\thash\tseconds\tips\tquirks\tstatus\n";
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        const Result& result = results[i];
+        double ips = result.seconds > 0 ? result.cycles / result.seconds : 0;
+
+        totalCycles += result.cycles;
+        file << jobs[i].rom << '\t' << result.cycles << '\t'
+             << std::hex << std::setw(16) << std::setfill('0') << result.hash << std::dec << '\t'
+             << std::fixed << std::setprecision(6) << result.seconds << '\t'
+             << std::setprecision(0) << ips << '\t' << quirkProfileName(result.profile) << '\t' << result.status << '\n';
+    }
+
+    file.close();
+
+    std::cout << "Jobs:     " << jobs.size() << " on " << threads << " threads\n";
+    std::cout << "ROMs:     " << catalog.size() << " distinct, " << catalog.getRejectedCount() << " rejected from the ROM directory\n";
+    std::cout << "Cycles:   " << totalCycles << '\n';
+    std::cout << "Seconds:  " << seconds << '\n';
+    std::cout << "IPS:      " << std::fixed << std::setprecision(0) << totalCycles / seconds << '\n';
+
+    if (!file) {
+        std::cout << "Could not write results: " << output << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,443 @@
+#include "chip8.hpp"
+#include "jit.hpp"
+#include "lockstep.hpp"
+#include "rewind.hpp"
+#include "romimage.hpp"
+#include "profiler.hpp"
+#include "quirks.hpp"
+#include "tracer.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    struct DispatchName {
+        const char* name;
+        Chip8::Dispatch mode;
+    };
+
+    const DispatchName dispatchNames[] = {
+        { "table", Chip8::Dispatch::Table },
+        { "threaded", Chip8::Dispatch::Threaded },
+        { "cached", Chip8::Dispatch::Cached },
+        { "jit", Chip8::Dispatch::Jit }
+    };
+
+    // ROMs every --verify runs after the ones given, for traps those may
+    // never reach
+    struct BuiltinRom {
+        const char* name;
+        std::vector<uint8_t> bytes;
+    };
+
+    const BuiltinRom builtinRoms[] = {
+        // Adds to V0 and calls itself until the 17th call overflows the stack
+        { "call-overflow", { 0x70, 0x01, 0x22, 0x00 } },
+        // Returns from one call, then returns again with nothing on the stack
+        { "return-underflow", { 0x22, 0x06, 0x00, 0xEE, 0x00, 0x00, 0x71, 0x01, 0x00, 0xEE } }
+    };
+
+    // Runs every dispatch mode against the table interpreter with the same seed and
+    // compares the complete machine state. The reference runs every cycle, so
+    // idle skipping is checked too. Cycles are fed in uneven batches so blocks
+    // get cut short at batch boundaries too.
+    bool verify(const char* name, const RomImage& rom, unsigned long long cycles, bool xoChip, QuirkProfile profile) {
+        bool ok = true;
+
+        for (const DispatchName& dispatch : dispatchNames) {
+            std::unique_ptr<Chip8> reference = Chip8::create(xoChip, profile);
+            std::unique_ptr<Chip8> candidate = Chip8::create(xoChip, profile);
+            reference->setIdleSkip(false);
+            reference->seed(cycles);
+            candidate->seed(cycles);
+            candidate->setDispatch(dispatch.mode);
+
+            if (!reference->loadROM(rom) || !candidate->loadROM(rom)) {
+                std::cout << "Could not load ROM: " << name << '\n';
+                return false;
+            }
+
+            unsigned long long done = 0;
+            unsigned long long batch = 1;
+
+            while (done < cycles) {
+                unsigned long long count = std::min(batch, cycles - done);
+                reference->run(count);
+                candidate->run(count);
+                reference->tickTimers();
+                candidate->tickTimers();
+                done += count;
+                batch = batch * 7 % 997 + 1;
+            }
+
+            bool match = reference->sameState(*candidate);
+            std::cout << name << ": " << dispatch.name << (match ? " matches\n" : " MISMATCH\n");
+            ok = ok && match;
+        }
+
+        return ok;
+    }
+
+    // Snapshots the table interpreter halfway through, restores the snapshot into
+    // a JIT machine that has already run the whole ROM, and checks the two finish
+    // in the same state. The restored machine must drop everything it compiled.
+    // The built-in ROMs have trapped by then, with sp at either end of the stack.
+    bool verifySaveState(const char* name, const RomImage& rom, unsigned long long cycles, bool xoChip, QuirkProfile profile) {
+        std::unique_ptr<Chip8> reference = Chip8::create(xoChip, profile);
+        std::unique_ptr<Chip8> restored = Chip8::create(xoChip, profile);
+        reference->seed(cycles);
+        restored->seed(cycles + 1);
+        restored->setDispatch(Chip8::Dispatch::Jit);
+
+        if (!reference->loadROM(rom) || !restored->loadROM(rom)) {
+            std::cout << "Could not load ROM: " << name << '\n';
+            return false;
+        }
+
+        reference->run(cycles / 2);
+        reference->tickTimers();
+        std::vector<uint8_t> state = reference->saveState();
+
+        restored->run(cycles);
+        bool match = restored->loadState(state.data(), state.size());
+
+        reference->run(cycles - cycles / 2);
+        restored->run(cycles - cycles / 2);
+        match = match && reference->sameState(*restored);
+
+        std::cout << name << ": savestate" << (match ? " matches\n" : " MISMATCH\n");
+        return match;
+    }
+
+    // Records a frame every few hundred cycles, then steps all the way back
+    // and checks that every restored frame hashes the same as when recorded.
+    // The built-in ROMs trap early, so most frames are of a trapped machine.
+    bool verifyRewind(const char* name, const RomImage& rom, unsigned long long cycles, bool xoChip, QuirkProfile profile) {
+        const unsigned long long frameCycles = 300;
+        std::unique_ptr<Chip8> chip8 = Chip8::create(xoChip, profile);
+        Rewind rewind;
+        std::vector<uint64_t> hashes;
+        chip8->seed(cycles);
+
+        if (!chip8->loadROM(rom)) {
+            std::cout << "Could not load ROM: " << name << '\n';
+            return false;
+        }
+
+        for (unsigned long long done = 0; done < cycles; done += frameCycles) {
+            chip8->run(frameCycles);
+            chip8->tickTimers();
+            rewind.push(*chip8);
+            hashes.push_back(chip8->stateHash());
+        }
+
+        bool match = rewind.getFrameCount() == hashes.size();
+        hashes.pop_back();
+
+        while (match && rewind.stepBack(*chip8)) {
+            match = chip8->stateHash() == hashes.back();
+            hashes.pop_back();
+        }
+
+        match = match && hashes.empty();
+        std::cout << name << ": rewind" << (match ? " matches\n" : " MISMATCH\n");
+        return match;
+    }
+
+    // Runs the lockstep engine against one table interpreter per lane. Each lane
+    // gets its own seed, so lanes split apart on the first random branch.
+    bool verifyLockstep(const char* name, const RomImage& rom, unsigned long long cycles, std::size_t laneCount) {
+        LockstepEngine engine(laneCount);
+        std::vector<std::unique_ptr<Chip8>> references;
+
+        if (!engine.loadROM(rom)) {
+            std::cout << "Could not load ROM: " << name << '\n';
+            return false;
+        }
+
+        for (std::size_t lane = 0; lane < laneCount; ++lane) {
+            references.push_back(Chip8::create());
+            engine.seed(lane, cycles + lane);
+            references[lane]->seed(cycles + lane);
+            references[lane]->loadROM(rom);
+        }
+
+        unsigned long long done = 0;
+        unsigned long long batch = 1;
+
+        while (done < cycles) {
+            unsigned long long count = std::min(batch, cycles - done);
+            engine.run(count);
+            engine.tickTimers();
+
+            for (std::unique_ptr<Chip8>& reference : references) {
+                reference->run(count);
+                reference->tickTimers();
+            }
+
+            done += count;
+            batch = batch * 7 % 997 + 1;
+        }
+
+        std::size_t matching = 0;
+
+        for (std::size_t lane = 0; lane < laneCount; ++lane) {
+            matching += engine.stateHash(lane) == references[lane]->stateHash();
+        }
+
+        bool match = matching == laneCount;
+        std::cout << name << ": lockstep " << engine.getKernelName() << ' '
+                  << (match ? "matches\n" : "MISMATCH\n");
+        return match;
+    }
+
+    // Every check --verify makes of one ROM
+    bool verifyRom(const char* name, const RomImage& rom, unsigned long long cycles, bool xoChip, QuirkProfile profile,
+                   std::size_t laneCount) {
+        bool ok = verify(name, rom, cycles, xoChip, profile);
+        ok = verifySaveState(name, rom, cycles, xoChip, profile) && ok;
+        ok = verifyRewind(name, rom, cycles, xoChip, profile) && ok;
+
+        // Lanes only emulate the 4 KB core without quirks
+        if (laneCount > 0 && !xoChip && profile == QuirkProfile::Default) {
+            ok = verifyLockstep(name, rom, cycles, laneCount) && ok;
+        }
+
+        return ok;
+    }
+
+    int benchLockstep(const char* filename, unsigned long long cycles, unsigned long long frameCycles, std::size_t laneCount) {
+        LockstepEngine engine(laneCount);
+
+        if (!engine.loadROM(filename)) {
+            std::cout << "Could not open ROM: " << filename << '\n';
+            return 1;
+        }
+
+        for (std::size_t lane = 0; lane < laneCount; ++lane) {
+            engine.seed(lane, lane);
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        for (unsigned long long done = 0; done < cycles; done += frameCycles) {
+            engine.run(std::min(frameCycles, cycles - done));
+            engine.tickTimers();
+        }
+
+        auto endTime = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+        std::cout << "Lanes:    " << laneCount << " (" << engine.getKernelName() << ")\n";
+        std::cout << "Cycles:   " << cycles << " per lane\n";
+        std::cout << "Seconds:  " << seconds << '\n';
+        std::cout << "IPS:      " << std::fixed << std::setprecision(0) << cycles * laneCount / seconds << " across all lanes\n";
+        return 0;
+    }
+}
+
+// Runs a ROM headless for a fixed number of cycles and reports throughput.
+// The timers tick once every frameCycles cycles, standing in for 60 Hz.
+int main(int argc, char **argv) {
+    unsigned long long cycles = 10000000;
+    unsigned long long frameCycles = 10000;
+    Chip8::Dispatch dispatch = Chip8::Dispatch::Table;
+    std::size_t laneCount = 0;
+    const char* traceFilename = nullptr;
+    bool verifyMode = false;
+    bool xoChip = false;
+    bool quirksGiven = false;
+    QuirkProfile profile = QuirkProfile::Default;
+    QuirkDatabase quirkDatabase;
+    std::vector<const char*> filenames;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--dispatch") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            bool known = false;
+
+            for (const DispatchName& name : dispatchNames) {
+                if (std::strcmp(mode, name.name) == 0) {
+                    dispatch = name.mode;
+                    known = true;
+                }
+            }
+
+            if (!known) {
+                std::cout << "Unknown dispatch mode: " << mode << '\n';
+                std::exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--frame") == 0 && i + 1 < argc) {
+            frameCycles = std::max(1ull, std::strtoull(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            traceFilename = argv[++i];
+        } else if (std::strcmp(argv[i], "--lanes") == 0 && i + 1 < argc) {
+            laneCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--verify") == 0) {
+            verifyMode = true;
+        } else if (std::strcmp(argv[i], "--xo") == 0) {
+            xoChip = true;
+        } else if (std::strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            if (!parseQuirkProfile(argv[++i], profile)) {
+                std::cout << "Unknown quirk profile: " << argv[i] << '\n';
+                std::exit(1);
+            }
+
+            quirksGiven = true;
+        } else if (std::strcmp(argv[i], "--quirk-db") == 0 && i + 1 < argc) {
+            if (!quirkDatabase.load(argv[++i])) {
+                std::cout << "Could not read quirk database: " << argv[i] << '\n';
+                std::exit(1);
+            }
+        } else if (!verifyMode && !filenames.empty()) {
+            cycles = std::strtoull(argv[i], nullptr, 10);
+        } else {
+            filenames.push_back(argv[i]);
+        }
+    }
+
+    if (filenames.empty()) {
+        std::cout << "Usage: " << argv[0] << " [--xo] [--quirks profile] [--quirk-db file] [--dispatch table|threaded|cached|jit] [--frame N] [--trace file] <path to rom> [cycles]\n";
+        std::cout << "       " << argv[0] << " --lanes N [--frame N] <path to rom> [cycles]\n";
+        std::cout << "       " << argv[0] << " --verify [--xo] [--quirks profile] [--quirk-db file] [--cycles N] [--lanes N] <path to rom>...\n";
+        std::cout << "Quirk profiles: default, cosmac, schip, xochip\n";
+        std::exit(0);
+    }
+
+    // Without --quirks, XO-CHIP ROMs get the XO-CHIP quirks
+    if (!quirksGiven && xoChip) {
+        profile = QuirkProfile::XoChip;
+    }
+
+    if (verifyMode) {
+        bool ok = true;
+
+        for (const char* filename : filenames) {
+            std::shared_ptr<const RomImage> rom = RomImage::open(filename, xoChip ? 0x10000 : 0x1000);
+
+            if (!rom) {
+                std::cout << "Could not open ROM: " << filename << '\n';
+                ok = false;
+                continue;
+            }
+
+            QuirkProfile romProfile = profile;
+            quirkDatabase.lookup(rom->getHash(), romProfile);
+
+            ok = verifyRom(filename, *rom, cycles, xoChip, romProfile, laneCount) && ok;
+        }
+
+        for (const BuiltinRom& builtin : builtinRoms) {
+            std::shared_ptr<const RomImage> rom = RomImage::fromBytes(builtin.bytes.data(), builtin.bytes.size(), 0x1000);
+
+            ok = verifyRom(builtin.name, *rom, cycles, xoChip, profile, laneCount) && ok;
+        }
+
+        return ok ? 0 : 1;
+    }
+
+    const char* filename = filenames[0];
+
+    profile = quirkDatabase.lookupFile(filename, profile);
+
+    if (laneCount > 0) {
+        if (xoChip || profile != QuirkProfile::Default) {
+            std::cout << "Lanes only run the 4 KB core without quirks\n";
+            std::exit(1);
+        }
+
+        return benchLockstep(filename, cycles, frameCycles, laneCount);
+    }
+
+    std::unique_ptr<Chip8> chip8 = Chip8::create(xoChip, profile);
+    Tracer tracer;
+    chip8->setDispatch(dispatch);
+
+    if (!chip8->loadROM(filename)) {
+        std::cout << "Could not open ROM: " << filename << '\n';
+        std::exit(1);
+    }
+
+    if (traceFilename) {
+        if (!tracer.open(traceFilename)) {
+            std::cout << "Could not write trace: " << traceFilename << '\n';
+            std::exit(1);
+        }
+
+        chip8->setTracer(&tracer);
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (unsigned long long done = 0; done < cycles; done += frameCycles) {
+        chip8->run(std::min(frameCycles, cycles - done));
+        chip8->tickTimers();
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+    chip8->setTracer(nullptr);
+    tracer.close();
+
+    if (chip8->isTrapped()) {
+        std::cout << "Invalid opcode " << std::hex << std::setw(4) << std::setfill('0') << chip8->getTrapOpcode()
+                  << " at " << std::setw(3) << chip8->getTrapAddress() << std::dec << '\n';
+    }
+
+    std::cout << "Cycles:   " << cycles << '\n';
+    std::cout << "Seconds:  " << seconds << '\n';
+    std::cout << "IPS:      " << std::fixed << std::setprecision(0) << cycles / seconds << '\n';
+
+    // The hash is what a quirk database line lists the ROM under
+    uint64_t romHash = 0;
+
+    if (QuirkDatabase::hashFile(filename, romHash)) {
+        std::cout << "Quirks:   " << quirkProfileName(profile) << ", ROM hash "
+                  << std::hex << std::setw(16) << std::setfill('0') << romHash << std::dec << '\n';
+    }
+
+    if (dispatch == Chip8::Dispatch::Cached || dispatch == Chip8::Dispatch::Jit) {
+        std::cout << "Blocks:   " << chip8->getBlockCache().getCompiledCount() << " compiled, "
+                  << chip8->getBlockCache().getInvalidatedCount() << " invalidated\n";
+    }
+
+    if (chip8->getJit()) {
+        std::cout << "Native:   " << chip8->getJit()->getCompiledCount() << " blocks\n";
+    }
+
+    if (chip8->getSkippedCycles() > 0) {
+        std::cout << "Idle:     " << chip8->getSkippedCycles() << " cycles skipped\n";
+    }
+
+    if (traceFilename) {
+        std::cout << "Trace:    " << tracer.getRecordCount() << " records, " << tracer.getDroppedCount() << " dropped\n";
+    }
+
+    if (chip8->getProfiler()) {
+        chip8->getProfiler()->dump("profile.json");
+    }
+
+    const int snapshots = 10000;
+    std::vector<uint8_t> state(chip8->getStateSize());
+    auto saveStart = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < snapshots; ++i) {
+        chip8->saveState(state.data());
+    }
+
+    auto loadStart = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < snapshots; ++i) {
+        chip8->loadState(state.data(), state.size());
+    }
+
+    auto loadEnd = std::chrono::steady_clock::now();
+
+    std::cout << "Snapshot: " << state.size() << " bytes, "
+              << std::chrono::duration<double, std::nano>(loadStart - saveStart).count() / snapshots << " ns to save, "
+              << std::chrono::duration<double, std::nano>(loadEnd - loadStart).count() / snapshots << " ns to load\n";
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "blockcache.hpp"
+#include "chip8.hpp"
+
+BlockCache::BlockCache(unsigned int memorySize)
+    : memorySize(memorySize), blocks(memorySize), coverage(memorySize, 0), invalidated(memorySize, false) {
+    compiledCount = 0;
+    invalidatedCount = 0;
+}
+
+void BlockCache::clear() {
+    for (unsigned int i = 0; i < memorySize; ++i) {
+        blocks[i].reset();
+    }
+
+    std::fill(coverage.begin(), coverage.end(), 0);
+}
+
+bool BlockCache::wasInvalidated(unsigned int address) const {
+    return address < memorySize && invalidated[address];
+}
+
+unsigned long long BlockCache::getCompiledCount() const {
+    return compiledCount;
+}
+
+unsigned long long BlockCache::getInvalidatedCount() const {
+    return invalidatedCount;
+}
+
+Block* BlockCache::compile(unsigned int address, const uint8_t* memory) {
+    const Instruction* table = Chip8::decodeTable();
+    std::unique_ptr<Block> block(new Block);
+    unsigned int pc = address;
+
+    block->start = address;
+    block->hits = 0;
+    block->native = nullptr;
+    block->nativeLength = 0;
+
+    while (pc + 1 < memorySize && block->instrs.size() < MAX_BLOCK_LENGTH) {
+        const Instruction& instr = table[(memory[pc] << 8) | memory[pc+1]];
+        block->instrs.push_back(instr);
+        pc += 2;
+
+        if (Chip8::endsBlock(instr.op)) {
+            break;
+        }
+    }
+
+    block->end = pc;
+
+    for (unsigned int i = block->start; i < block->end; ++i) {
+        coverage[i]++;
+    }
+
+    compiledCount++;
+    blocks[address] = std::move(block);
+    return blocks[address].get();
+}
+
+void BlockCache::invalidateRange(unsigned int address, unsigned int length) {
+    // Only blocks starting within one maximum block length before the write can reach it
+    unsigned int reach = MAX_BLOCK_LENGTH * 2;
+    unsigned int first = address >= reach ? address - reach + 1 : 0;
+    unsigned int last = std::min(address + length, memorySize);
+
+    for (unsigned int start = first; start < last; ++start) {
+        const Block* block = blocks[start].get();
+
+        if (block && block->end > address) {
+            drop(start);
+        }
+    }
+}
+
+void BlockCache::drop(unsigned int start) {
+    const Block* block = blocks[start].get();
+
+    for (unsigned int i = block->start; i < block->end; ++i) {
+        coverage[i]--;
+    }
+
+    invalidated[start] = true;
+    invalidatedCount++;
+    blocks[start].reset();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "instruction.hpp"
+
+class Chip8;
+
+// A straight-line run of pre-decoded instructions
+struct Block {
+    unsigned int start;         // Address of the first instruction
+    unsigned int end;           // One past the last byte covered, up to memorySize
+    std::vector<Instruction> instrs;
+
+    uint32_t hits;                          // Times run, for picking hot blocks to JIT
+    void (*native)(Chip8* chip8);           // JIT translation of the first nativeLength instructions
+    unsigned int nativeLength;
+};
+
+// Pre-decoded blocks indexed by start address. A block ends at the first
+// instruction that can leave straight-line flow or write to memory, so
+// invalidating it mid-run never pulls instructions out from under the caller.
+// Sized for the memory of the core that owns it.
+class BlockCache {
+    public:
+        static const unsigned int MAX_BLOCK_LENGTH = 64;   // Instructions per block
+
+        explicit BlockCache(unsigned int memorySize = 4096);
+
+        // Returns the block starting at address, decoding it on a miss.
+        // Returns nullptr when address is too close to the end of memory to fetch.
+        Block* lookup(unsigned int address, const uint8_t* memory) {
+            if (address >= memorySize - 1) {
+                return nullptr;
+            }
+
+            Block* block = blocks[address].get();
+            return block ? block : compile(address, memory);
+        }
+
+        // Drops every block covering a byte in [address, address + length),
+        // masked to memory and wrapping at its end as the core's writes do
+        void invalidate(unsigned int address, unsigned int length) {
+            address &= memorySize - 1;
+
+            if (address + length > memorySize) {
+                invalidate(0, address + length - memorySize);
+                length = memorySize - address;
+            }
+
+            for (unsigned int i = address; i < address + length; ++i) {
+                if (coverage[i]) {
+                    invalidateRange(address, length);
+                    return;
+                }
+            }
+        }
+
+        void clear();
+
+        // Whether a block starting at address has ever been dropped by a write
+        bool wasInvalidated(unsigned int address) const;
+
+        unsigned long long getCompiledCount() const;
+        unsigned long long getInvalidatedCount() const;
+
+    private:
+        unsigned int memorySize;
+        std::vector<std::unique_ptr<Block>> blocks;
+        std::vector<uint8_t> coverage;      // Number of blocks covering each byte
+        std::vector<bool> invalidated;      // Start addresses of blocks dropped by a write
+        unsigned long long compiledCount;
+        unsigned long long invalidatedCount;
+
+        Block* compile(unsigned int address, const uint8_t* memory);
+        void invalidateRange(unsigned int address, unsigned int length);
+        void drop(unsigned int start);
+};
@@ -1,4 +1,73 @@
 #include "chip8.hpp"
+#include "jit.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+
+template <std::size_t MemorySize, class... Quirks>
+const typename Chip8Core<MemorySize, Quirks...>::Handler Chip8Core<MemorySize, Quirks...>::handlers[OP_COUNT] = {
+    handler<&Chip8Core::op_0NNN>, handler<&Chip8Core::op_00E0>, handler<&Chip8Core::op_00EE>, handler<&Chip8Core::op_1NNN>,
+    handler<&Chip8Core::op_2NNN>, handler<&Chip8Core::op_3XNN>, handler<&Chip8Core::op_4XNN>, handler<&Chip8Core::op_5XY0>,
+    handler<&Chip8Core::op_6XNN>, handler<&Chip8Core::op_7XNN>, handler<&Chip8Core::op_8XY0>, handler<&Chip8Core::op_8XY1>,
+    handler<&Chip8Core::op_8XY2>, handler<&Chip8Core::op_8XY3>, handler<&Chip8Core::op_8XY4>, handler<&Chip8Core::op_8XY5>,
+    handler<&Chip8Core::op_8XY6>, handler<&Chip8Core::op_8XY7>, handler<&Chip8Core::op_8XYE>, handler<&Chip8Core::op_9XY0>,
+    handler<&Chip8Core::op_ANNN>, handler<&Chip8Core::op_BNNN>, handler<&Chip8Core::op_CXNN>, handler<&Chip8Core::op_DXYN>,
+    handler<&Chip8Core::op_EX9E>, handler<&Chip8Core::op_EXA1>, handler<&Chip8Core::op_FX07>, handler<&Chip8Core::op_FX0A>,
+    handler<&Chip8Core::op_FX15>, handler<&Chip8Core::op_FX18>, handler<&Chip8Core::op_FX1E>, handler<&Chip8Core::op_FX29>,
+    handler<&Chip8Core::op_FX33>, handler<&Chip8Core::op_FX55>, handler<&Chip8Core::op_FX65>, handler<&Chip8Core::op_00CN>,
+    handler<&Chip8Core::op_00FB>, handler<&Chip8Core::op_00FC>, handler<&Chip8Core::op_00FD>, handler<&Chip8Core::op_00FE>,
+    handler<&Chip8Core::op_00FF>, handler<&Chip8Core::op_DXY0>, handler<&Chip8Core::op_FX30>, handler<&Chip8Core::op_FX75>,
+    handler<&Chip8Core::op_FX85>, handler<&Chip8Core::op_00DN>, handler<&Chip8Core::op_5XY2>, handler<&Chip8Core::op_5XY3>,
+    handler<&Chip8Core::op_F000>, handler<&Chip8Core::op_FN01>, handler<&Chip8Core::op_F002>, handler<&Chip8Core::op_FX3A>,
+    handler<&Chip8Core::op_INVALID>
+};
+
+namespace {
+    const char STATE_MAGIC[4] = { 'C', '8', 'S', 'T' };
+
+    template <class T>
+    uint8_t* put(uint8_t* out, const T& value) {
+        std::memcpy(out, &value, sizeof(value));
+        return out + sizeof(value);
+    }
+
+    template <class T>
+    const uint8_t* get(const uint8_t* in, T& value) {
+        std::memcpy(&value, in, sizeof(value));
+        return in + sizeof(value);
+    }
+
+    // What a wait loop has to come back to for skipIdleLoop() to treat it as periodic
+    struct LoopState {
+        uint8_t registers[16];
+        uint16_t indexReg;
+        uint16_t pc;
+        uint8_t sp;
+        uint8_t delayTimer;
+        uint8_t soundTimer;
+        uint8_t keyWait;
+
+        bool operator==(const LoopState& other) const {
+            return std::equal(registers, registers + 16, other.registers) && indexReg == other.indexReg
+                && pc == other.pc && sp == other.sp && delayTimer == other.delayTimer
+                && soundTimer == other.soundTimer && keyWait == other.keyWait;
+        }
+    };
+
+    // True for instructions that change nothing but the registers, I, pc, the
+    // timers and the FX0A wait, which is all a LoopState covers
+    bool onlyWaits(uint8_t op) {
+        switch (op) {
+            case Chip8::OP_00E0: case Chip8::OP_00EE: case Chip8::OP_2NNN: case Chip8::OP_CXNN:
+            case Chip8::OP_DXYN: case Chip8::OP_FX33: case Chip8::OP_FX55: case Chip8::OP_00CN:
+            case Chip8::OP_00FB: case Chip8::OP_00FC: case Chip8::OP_00FE: case Chip8::OP_00FF:
+            case Chip8::OP_DXY0: case Chip8::OP_FX75: case Chip8::OP_00DN: case Chip8::OP_5XY2:
+            case Chip8::OP_F002: case Chip8::OP_INVALID:
+                return false;
+            default:
+                return true;
+        }
+    }
+}
 
 const std::array<uint8_t, 80> Chip8::fontset = {
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
@@ -19,48 +88,117 @@ const std::array<uint8_t, 80> Chip8::fontset = {
 	0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-Chip8::Chip8() {
-    std::fill(memory, memory+4096, 0);
+const std::array<uint8_t, 160> Chip8::bigFontset = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+Chip8::Chip8(std::size_t memorySize, unsigned int quirks) : memorySize(memorySize), quirks(quirks), blockCache(memorySize) {
     std::fill(registers, registers+16, 0);
     std::fill(stack, stack+16, 0);
-    std::fill(keyPressedState, keyPressedState+16, 0);
-    std::fill(display, display+2048, 0);
+    std::fill(rplFlags, rplFlags+16, 0);
+    std::fill(audioPattern, audioPattern+16, 0);
+    display.clear();
 
     sp = 0;
+    delayTimer = 0;
+    soundTimer = 0;
     indexReg = 0;
     pc = 0x200;
-    rng = std::default_random_engine(std::chrono::system_clock::now().time_since_epoch().count());
-    rand = std::uniform_int_distribution<uint8_t>(0, 255u);
-    
-    for (int i = 0; i < 80; ++i) {
-        memory[i] = fontset[i];
+    keys = 0;
+    keyWait = NO_KEY_WAIT;
+    hires = false;
+    planeMask = 1;
+    pitch = DEFAULT_PITCH;
+    patternLoaded = false;
+    rng.seed(std::chrono::system_clock::now().time_since_epoch().count());
+    dispatch = Dispatch::Table;
+    tracer = nullptr;
+    idleSkip = true;
+    skippedCycles = 0;
+    trapped = false;
+    trapOpcode = 0;
+    trapAddress = 0;
+
+    if constexpr (PROFILING) {
+        profiler.reset(new Profiler());
     }
 }
 
 Chip8::~Chip8() {
 }
 
-void Chip8::loadROM(char const* filename) {
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+namespace {
+    // The quirks of each profile, as listed in quirks.hpp
+    template <std::size_t MemorySize>
+    std::unique_ptr<Chip8> createCore(QuirkProfile profile) {
+        switch (profile) {
+            case QuirkProfile::Cosmac:
+                return std::unique_ptr<Chip8>(new Chip8Core<MemorySize, QuirkShiftVY, QuirkIncrementI>());
+            case QuirkProfile::SuperChip:
+                return std::unique_ptr<Chip8>(new Chip8Core<MemorySize, QuirkJumpVX>());
+            case QuirkProfile::XoChip:
+                return std::unique_ptr<Chip8>(new Chip8Core<MemorySize, QuirkShiftVY, QuirkIncrementI, QuirkWrapSprites>());
+            default:
+                return std::unique_ptr<Chip8>(new Chip8Core<MemorySize>());
+        }
+    }
+}
 
-    if (file.is_open()) {
-        std::streampos size = file.tellg();
-        char* buffer = new char[size];
+std::unique_ptr<Chip8> Chip8::create(bool xoChip, QuirkProfile profile) {
+    if (xoChip) {
+        return createCore<0x10000>(profile);
+    }
 
-        file.seekg(0, std::ios::beg);
-        file.read(buffer, size);
-        file.close();
+    return createCore<0x1000>(profile);
+}
 
-        for (long i = 0; i < size; i++) {
-            memory[0x200 + i] = buffer[i];
-        }
+template <std::size_t MemorySize, class... Quirks>
+Chip8Core<MemorySize, Quirks...>::Chip8Core() : Chip8(MemorySize, quirkBits<Quirks...>) {
+    std::fill(memory, memory+MemorySize, 0);
 
-        delete[] buffer;
+    for (int i = 0; i < 80; ++i) {
+        memory[i] = fontset[i];
     }
+
+    std::copy(bigFontset.begin(), bigFontset.end(), memory + 0xA0);
 }
 
-void Chip8::printMemory() {
-    for (int i = 0; i < 4096; ++i) {
+bool Chip8::loadROM(char const* filename) {
+    std::shared_ptr<const RomImage> rom = RomImage::open(filename, memorySize);
+
+    return rom && loadROM(*rom);
+}
+
+template <std::size_t MemorySize, class... Quirks>
+bool Chip8Core<MemorySize, Quirks...>::loadROM(const RomImage& rom) {
+    // An image validated for a larger core may not fit this one
+    if (rom.size() > RomImage::maxSize(MemorySize)) {
+        return false;
+    }
+
+    std::copy(rom.data(), rom.data() + rom.size(), memory + RomImage::LOAD_ADDRESS);
+    blockCache.clear();
+    return true;
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::printMemory() {
+    for (std::size_t i = 0; i < MemorySize; ++i) {
         if (i % 32 == 0) {
             std::cout << '\n';
         }
@@ -78,11 +216,18 @@ void Chip8::printRegisters() {
 
 void Chip8::printDisplay() {
     std::cout << "Display:\n";
-    for (int i = 0; i < 2048; ++i) {
-        if (i % 32 == 0) {
-            std::cout << '\n';
+    for (unsigned int row = 0; row < Display::height(hires); ++row) {
+        std::cout << std::hex << std::setfill('0');
+
+        for (unsigned int plane = 0; plane < (isXoChip() ? Display::PLANES : 1); ++plane) {
+            std::cout << (plane ? " " : "") << std::setw(16) << display.planes[plane][row][0];
+
+            if (hires) {
+                std::cout << std::setw(16) << display.planes[plane][row][1];
+            }
         }
-        std::cout << std::hex << std::setw(2) << std::setfill('0') << unsigned(display[i]) << ' ';
+
+        std::cout << '\n';
     }
     std::cout << std::dec;
 }
@@ -97,105 +242,98 @@ void Chip8::pushToStack(unsigned short address) {
     sp++;
 }
 
-void Chip8::op_0NNN(unsigned short opcode) {
-    unsigned short nnn = opcode & 0x0FFFu;
-    pc = nnn;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_0NNN(const Instruction& instr) {
+    pc = instr.nnn;
 }
 
-void Chip8::op_00E0(unsigned short opcode) {
-    std::fill(display, display+2048, 0);
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_00E0(const Instruction& instr) {
+    display.clear(selectedPlanes());
 }
 
-void Chip8::op_00EE(unsigned short opcode) {
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_00EE(const Instruction& instr) {
+    // Returning with nothing on the stack traps, as running an invalid opcode does
+    if (sp == 0) {
+        op_INVALID(instr);
+        return;
+    }
+
     pc = popFromStack();
 }
 
-void Chip8::op_1NNN(unsigned short opcode) {
-    unsigned short jumpAddress = opcode & 0x0FFFu;
-    pc = jumpAddress;
-    // std::cout << "Set pc to address " << std::hex << std::setw(3) << std::setfill('0') << jumpAddress << std::dec << '\n';
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_1NNN(const Instruction& instr) {
+    pc = instr.nnn;
 }
 
-void Chip8::op_2NNN(unsigned short opcode) {
-    unsigned short jumpAddress = opcode & 0x0FFFu;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_2NNN(const Instruction& instr) {
+    // A 17th nested call traps instead of writing past the stack
+    if (sp == 16) {
+        op_INVALID(instr);
+        return;
+    }
+
     pushToStack(pc);
-    pc = jumpAddress;
+    pc = instr.nnn;
 }
 
-void Chip8::op_3XNN(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char compareTo = opcode & 0x00FFu;
-
-    if (registers[x] == compareTo) {
-        instructionStep();
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_3XNN(const Instruction& instr) {
+    if (registers[instr.x] == instr.nn) {
+        skipInstruction();
     }
-
 }
 
-void Chip8::op_4XNN(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char compareTo = opcode & 0x00FFu;
-
-    if (registers[x] != compareTo) {
-        instructionStep();
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_4XNN(const Instruction& instr) {
+    if (registers[instr.x] != instr.nn) {
+        skipInstruction();
     }
 }
 
-void Chip8::op_5XY0(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char y = (opcode & 0x00F0u) >> 4;
-
-    if (registers[x] == registers[y]) {
-        instructionStep();
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_5XY0(const Instruction& instr) {
+    if (registers[instr.x] == registers[instr.y]) {
+        skipInstruction();
     }
 }
 
-void Chip8::op_6XNN(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char data = opcode & 0x00FFu;
-    registers[x] = data;
-    // std::cout << "Set register " << +x << " to value " << std::hex << std::setw(2) << std::setfill('0') << data << std::dec << '\n';
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_6XNN(const Instruction& instr) {
+    registers[instr.x] = instr.nn;
 }
 
-void Chip8::op_7XNN(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char data = opcode & 0x00FFu;
-
-    registers[x] += data;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_7XNN(const Instruction& instr) {
+    registers[instr.x] += instr.nn;
 }
 
-void Chip8::op_8XY0(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char y = (opcode & 0x00F0u) >> 4;
-    
-    registers[x] = registers[y];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_8XY0(const Instruction& instr) {
+    registers[instr.x] = registers[instr.y];
 }
 
-void Chip8::op_8XY1(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char y = (opcode & 0x00F0u) >> 4;
-
-    registers[x] |= registers[y];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_8XY1(const Instruction& instr) {
+    registers[instr.x] |= registers[instr.y];
 }
 
-void Chip8::op_8XY2(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char y = (opcode & 0x00F0u) >> 4;
-
-    registers[x] &= registers[y];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_8XY2(const Instruction& instr) {
+    registers[instr.x] &= registers[instr.y];
 }
 
-void Chip8::op_8XY3(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char y = (opcode & 0x00F0u) >> 4;
-
-    registers[x] ^= registers[y];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_8XY3(const Instruction& instr) {
+    registers[instr.x] ^= registers[instr.y];
 }
 
-void Chip8::op_8XY4(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char y = (opcode & 0x00F0u) >> 4;
-    unsigned int sum = registers[x] + registers[y];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_8XY4(const Instruction& instr) {
+    unsigned int sum = registers[instr.x] + registers[instr.y];
 
     if (sum > 255) {
         registers[0xF] = 1;
@@ -203,395 +341,1103 @@ void Chip8::op_8XY4(unsigned short opcode) {
         registers[0xF] = 0;
     }
 
-    registers[x] += registers[y];
+    registers[instr.x] += registers[instr.y];
 }
 
-void Chip8::op_8XY5(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char y = (opcode & 0x00F0u) >> 4;
-
-    if (registers[x] > registers[y]) {
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_8XY5(const Instruction& instr) {
+    if (registers[instr.x] > registers[instr.y]) {
         registers[0xF] = 1;
     } else {
         registers[0xF] = 0;
     }
 
-    registers[x] -= registers[y];
+    registers[instr.x] -= registers[instr.y];
 }
 
-void Chip8::op_8XY6(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_8XY6(const Instruction& instr) {
+    if constexpr (SHIFT_VY) {
+        uint8_t value = registers[instr.y];
 
-    registers[0xF] = registers[x] & 1;
-    registers[x] >>= 1;
+        registers[0xF] = value & 1;
+        registers[instr.x] = value >> 1;
+    } else {
+        registers[0xF] = registers[instr.x] & 1;
+        registers[instr.x] >>= 1;
+    }
 }
 
-void Chip8::op_8XY7(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char y = (opcode & 0x00F0u) >> 4;
-
-    if (registers[y] > registers[x]) {
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_8XY7(const Instruction& instr) {
+    if (registers[instr.y] > registers[instr.x]) {
         registers[0xF] = 1;
     } else {
         registers[0xF] = 0;
     }
 
-    registers[x] = registers[y] - registers[x];
+    registers[instr.x] = registers[instr.y] - registers[instr.x];
 }
 
-void Chip8::op_8XYE(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_8XYE(const Instruction& instr) {
+    if constexpr (SHIFT_VY) {
+        uint8_t value = registers[instr.y];
 
-    registers[0xF] = (registers[x] & 0x80u) >> 7;
-    registers[x] <<= 1;
+        registers[0xF] = (value & 0x80u) >> 7;
+        registers[instr.x] = value << 1;
+    } else {
+        registers[0xF] = (registers[instr.x] & 0x80u) >> 7;
+        registers[instr.x] <<= 1;
+    }
 }
 
-void Chip8::op_9XY0(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char y = (opcode & 0x00F0u) >> 4;
-
-    if (registers[x] != registers[y]) {
-        instructionStep();
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_9XY0(const Instruction& instr) {
+    if (registers[instr.x] != registers[instr.y]) {
+        skipInstruction();
     }
 }
 
-void Chip8::op_ANNN(unsigned short opcode) {
-    unsigned short address = opcode & 0x0FFFu;
-    indexReg = address;
-    // std::cout << "Set index to " << indexReg << '\n';
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_ANNN(const Instruction& instr) {
+    indexReg = instr.nnn;
 }
 
-void Chip8::op_BNNN(unsigned short opcode) {
-    unsigned short address = opcode & 0x0FFFu;
-    pc = registers[0] + address;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_BNNN(const Instruction& instr) {
+    // SUPER-CHIP reads the opcode as BXNN
+    pc = registers[JUMP_VX ? instr.x : 0] + instr.nnn;
 }
 
-void Chip8::op_CXNN(unsigned short opcode) {
-    unsigned char x = (opcode & 0x0F00u) >> 8;
-    unsigned char byte = opcode & 0x00FFu;
-
-    registers[x] = rand(rng) & byte;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_CXNN(const Instruction& instr) {
+    registers[instr.x] = rng.next() & instr.nn;
 }
 
-void Chip8::op_DXYN(unsigned short opcode) {
-    uint8_t Vx = (opcode & 0x0F00) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0) >> 4u;
-    uint8_t height = opcode & 0x000Fu;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_DXYN(const Instruction& instr) {
+    Display::DrawStats stats = {};
+
+    registers[0xF] = display.draw<WRAP_SPRITES>(selectedPlanes(), hires, registers[instr.x], registers[instr.y], memory, indexReg,
+                                                ADDRESS_MASK, instr.n, false, PROFILING ? &stats : nullptr);
+
+    if constexpr (PROFILING) {
+        profiler->countDraw(stats.rows, stats.pixels);
+    }
+}
 
-    uint8_t xPos = registers[Vx] % 64;
-    uint8_t yPos = registers[Vy] % 32;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_EX9E(const Instruction& instr) {
+    if (keys & (1 << (registers[instr.x] & 0xF))) {
+        skipInstruction();
+    }
+}
 
-    registers[0xF] = 0;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_EXA1(const Instruction& instr) {
+    if (!(keys & (1 << (registers[instr.x] & 0xF)))) {
+        skipInstruction();
+    }
+}
 
-    for (unsigned int row = 0; row < height; ++row) {
-        uint8_t spriteByte = memory[indexReg + row];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX07(const Instruction& instr) {
+    registers[instr.x] = delayTimer;
+}
 
-        for (unsigned int col = 0; col < 8; ++col) {
-            uint8_t spritePixel = spriteByte & (0x80u >> col);
-            uint32_t* screenPixel = &display[(yPos + row) * 64 + (xPos + col)];
+// Takes the lowest key already down. With none down, parks on itself until
+// setKey() delivers the next press.
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX0A(const Instruction& instr) {
+    if (keys) {
+        uint8_t key = 0;
 
-            if (spritePixel) {
-                if (*screenPixel == 0xFFFFFFFF) {
-                    registers[0xF] = 1;
-                }
-                *screenPixel ^= 0xFFFFFFFF;
-            }
+        while (!(keys & (1 << key))) {
+            key++;
         }
+
+        registers[instr.x] = key;
+        keyWait = NO_KEY_WAIT;
+    } else {
+        keyWait = instr.x;
+        pc -= 2;
     }
-    // printDisplay();
 }
 
-void Chip8::op_EX9E(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX15(const Instruction& instr) {
+    delayTimer = registers[instr.x];
+}
 
-    if (keyPressedState[registers[x]] == 1) {
-        instructionStep();
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX18(const Instruction& instr) {
+    soundTimer = registers[instr.x];
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX1E(const Instruction& instr) {
+    indexReg += registers[instr.x];
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX29(const Instruction& instr) {
+    uint8_t fontCharacter = registers[instr.x];
+
+    indexReg = 0x50 + (5 * fontCharacter);
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX33(const Instruction& instr) {
+    uint8_t decimal = registers[instr.x];
+
+    for (int i = 2; i >= 0; --i) {
+        memory[(indexReg + i) & ADDRESS_MASK] = decimal % 10;
+        decimal /= 10;
     }
+
+    blockCache.invalidate(indexReg, 3);
 }
 
-void Chip8::op_EXA1(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX55(const Instruction& instr) {
+    for (int i = 0; i <= instr.x; ++i) {
+        memory[(indexReg + i) & ADDRESS_MASK] = registers[i];
+    }
 
-    if (keyPressedState[registers[x]] == 0) {
-        instructionStep();
+    blockCache.invalidate(indexReg, instr.x + 1);
+
+    if constexpr (INCREMENT_I) {
+        indexReg += instr.x + 1;
     }
 }
 
-void Chip8::op_FX07(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
-
-    registers[x] = delayTimer;
-}
-
-void Chip8::op_FX0A(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
-    
-    if (keyPressedState[0]) {
-        registers[x] = 0x0;
-    } else if (keyPressedState[1]) {
-        registers[x] = 0x1;
-    } else if (keyPressedState[2]) {
-        registers[x] = 0x2;
-    } else if (keyPressedState[3]) {
-        registers[x] = 0x3;
-    } else if (keyPressedState[4]) {
-        registers[x] = 0x4;
-    } else if (keyPressedState[5]) {
-        registers[x] = 0x5;
-    } else if (keyPressedState[6]) {
-        registers[x] = 0x6;
-    } else if (keyPressedState[7]) {
-        registers[x] = 0x7;
-    } else if (keyPressedState[8]) {
-        registers[x] = 0x8;
-    } else if (keyPressedState[9]) {
-        registers[x] = 0x9;
-    } else if (keyPressedState[10]) {
-        registers[x] = 0xA;
-    } else if (keyPressedState[11]) {
-        registers[x] = 0xB;
-    } else if (keyPressedState[12]) {
-        registers[x] = 0xC;
-    } else if (keyPressedState[13]) {
-        registers[x] = 0xD;
-    } else if (keyPressedState[14]) {
-        registers[x] = 0xE;
-    } else if (keyPressedState[15]) {
-        registers[x] = 0xF;
-    } else {
-        pc -= 2;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX65(const Instruction& instr) {
+    for (int i = 0; i <= instr.x; ++i) {
+        registers[i] = memory[(indexReg + i) & ADDRESS_MASK];
+    }
+
+    if constexpr (INCREMENT_I) {
+        indexReg += instr.x + 1;
     }
 }
 
-void Chip8::op_FX15(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
+// SCHIP scrolls go by pixels of the current resolution, as in Octo
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_00CN(const Instruction& instr) {
+    display.scrollDown(selectedPlanes(), hires, instr.n);
+}
 
-    delayTimer = registers[x];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_00FB(const Instruction& instr) {
+    display.scrollRight(selectedPlanes(), hires);
 }
 
-void Chip8::op_FX18(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_00FC(const Instruction& instr) {
+    display.scrollLeft(selectedPlanes(), hires);
+}
 
-    soundTimer = registers[x];
+// Exit. There is no host to return to, so it parks on itself like a jump to itself.
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_00FD(const Instruction& instr) {
+    pc -= 2;
 }
 
-void Chip8::op_FX1E(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
+// Switching resolution clears the display, every plane of it
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_00FE(const Instruction& instr) {
+    hires = false;
+    display.clear();
+}
 
-    indexReg += registers[x];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_00FF(const Instruction& instr) {
+    hires = true;
+    display.clear();
 }
 
-void Chip8::op_FX29(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
-    uint8_t fontCharacter = registers[x];
+// 16x16 sprite, two bytes per row. VF only says whether anything collided.
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_DXY0(const Instruction& instr) {
+    Display::DrawStats stats = {};
 
-    indexReg = 0x50 + (5 * fontCharacter);
+    registers[0xF] = display.draw<WRAP_SPRITES>(selectedPlanes(), hires, registers[instr.x], registers[instr.y], memory, indexReg,
+                                                ADDRESS_MASK, 16, true, PROFILING ? &stats : nullptr);
+
+    if constexpr (PROFILING) {
+        profiler->countDraw(stats.rows, stats.pixels);
+    }
 }
 
-void Chip8::op_FX33(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
-    uint8_t decimal = registers[x];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX30(const Instruction& instr) {
+    uint8_t fontCharacter = registers[instr.x];
 
-    for (int i = 2; i >= 0; --i) {
-        memory[indexReg] = decimal % 10;
-        decimal /= 10;
+    indexReg = 0xA0 + (10 * fontCharacter);
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX75(const Instruction& instr) {
+    for (int i = 0; i <= instr.x; ++i) {
+        rplFlags[i] = registers[i];
+    }
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX85(const Instruction& instr) {
+    for (int i = 0; i <= instr.x; ++i) {
+        registers[i] = rplFlags[i];
+    }
+}
+
+// XO-CHIP scroll up. Plain CHIP-8 decodes 00DN as a 0NNN call, which it keeps.
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_00DN(const Instruction& instr) {
+    if constexpr (!XO_CHIP) {
+        op_0NNN(instr);
+    } else {
+        display.scrollUp(planeMask, hires, instr.n);
     }
 }
 
-void Chip8::op_FX55(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
+// Saves VX to VY at I, last to first when Y is below X. I is left alone.
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_5XY2(const Instruction& instr) {
+    if constexpr (!XO_CHIP) {
+        op_INVALID(instr);
+    } else {
+        unsigned int count = (instr.x <= instr.y ? instr.y - instr.x : instr.x - instr.y) + 1;
+        int step = instr.x <= instr.y ? 1 : -1;
+
+        for (unsigned int i = 0; i < count; ++i) {
+            memory[(indexReg + i) & ADDRESS_MASK] = registers[instr.x + step * static_cast<int>(i)];
+        }
 
-    for (int i = 0; i <= x; ++i) {
-        memory[indexReg + i] = registers[i];
+        blockCache.invalidate(indexReg, count);
     }
 }
 
-void Chip8::op_FX65(unsigned short opcode) {
-    uint8_t x = (opcode & 0x0F00) >> 8;
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_5XY3(const Instruction& instr) {
+    if constexpr (!XO_CHIP) {
+        op_INVALID(instr);
+    } else {
+        unsigned int count = (instr.x <= instr.y ? instr.y - instr.x : instr.x - instr.y) + 1;
+        int step = instr.x <= instr.y ? 1 : -1;
 
-    for (int i = 0; i <= x; ++i) {
-        registers[i] = memory[indexReg + i];
+        for (unsigned int i = 0; i < count; ++i) {
+            registers[instr.x + step * static_cast<int>(i)] = memory[(indexReg + i) & ADDRESS_MASK];
+        }
     }
 }
 
+// Loads I from the word after it, the one instruction taking four bytes
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_F000(const Instruction& instr) {
+    if constexpr (!XO_CHIP) {
+        op_INVALID(instr);
+    } else {
+        indexReg = fetch();
+        instructionStep();
+    }
+}
+
+// Selects the planes later draws, clears and scrolls apply to. N sits where X usually does.
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FN01(const Instruction& instr) {
+    if constexpr (!XO_CHIP) {
+        op_INVALID(instr);
+    } else {
+        planeMask = instr.x & Display::ALL_PLANES;
+    }
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_F002(const Instruction& instr) {
+    if constexpr (!XO_CHIP) {
+        op_INVALID(instr);
+    } else {
+        for (int i = 0; i < 16; ++i) {
+            audioPattern[i] = memory[(indexReg + i) & ADDRESS_MASK];
+        }
+
+        patternLoaded = true;
+    }
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_FX3A(const Instruction& instr) {
+    if constexpr (!XO_CHIP) {
+        op_INVALID(instr);
+    } else {
+        pitch = registers[instr.x];
+    }
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::op_INVALID(const Instruction& instr) {
+    // Park on the offending instruction so the machine stays halted
+    pc -= 2;
+    trapAddress = pc;
+    trapOpcode = fetch();
+    trapped = true;
+}
+
 void Chip8::instructionStep() {
     pc += 2;
 }
 
-void Chip8::cycle() {
-    uint16_t opcode = fetch();
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::skipInstruction() {
+    if constexpr (XO_CHIP) {
+        if (fetch() == 0xF000) {
+            instructionStep();
+        }
+    }
+
     instructionStep();
-    // std::cout << "Fetched opcode: " << std::hex << std::setw(4) << std::setfill('0') << opcode << '\n';
-    decodeAndExecute(opcode);
-    // std::cout << "opcode executed successfully\n";
-    // std::cout << std::hex << std::setw(2) << std::setfill('0') << pc << '\n';
-    //printDisplay();
+}
+
+void Chip8::tickTimers() {
     if (delayTimer > 0) {
         delayTimer--;
     }
 
     if (soundTimer > 0) {
         soundTimer--;
+    }
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::cycle() {
+    uint16_t opcode = fetch();
+
+    if constexpr (PROFILING) {
+        profiler->count(pc, decodeTable()[opcode]);
+    }
+
+    instructionStep();
+    execute(decodeTable()[opcode]);
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::run(unsigned long long cycles) {
+    if (tracer) {
+        runTraced(cycles);
+        return;
+    }
+
+    if (!idleSkip) {
+        runDispatch(cycles);
+        return;
+    }
+
+    // Checks for a wait loop on entry and then every IDLE_CHECK_INTERVAL cycles
+    while (cycles > 0) {
+        cycles -= skipIdleLoop(cycles);
+
+        unsigned long long count = std::min(cycles, IDLE_CHECK_INTERVAL);
+        runDispatch(count);
+        cycles -= count;
+    }
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::runDispatch(unsigned long long cycles) {
+    if (dispatch == Dispatch::Threaded) {
+        runThreaded(cycles);
+    } else if (dispatch == Dispatch::Cached) {
+        runCached(cycles);
+    } else if (dispatch == Dispatch::Jit) {
+        runJit(cycles);
+    } else {
+        runTable(cycles);
+    }
+}
+
+// If pc is in a short loop that can only wait, at FX0A, FX07 or just before a
+// short backward jump, single-steps it until the registers, I, pc, sp and timers repeat.
+// Memory, the stack, the display and the RNG can't have changed, since any
+// instruction that writes them ends the search. From the repeat on, the
+// machine cycles through the same states, so whole periods are skipped.
+// Returns the cycles stepped plus the cycles skipped.
+template <std::size_t MemorySize, class... Quirks>
+unsigned long long Chip8Core<MemorySize, Quirks...>::skipIdleLoop(unsigned long long cycles) {
+    const Instruction* table = decodeTable();
+    uint8_t op = table[fetch()].op;
+
+    auto jumpsBack = [this, table](uint16_t address) {
+        const Instruction& instr = table[(memory[address & ADDRESS_MASK] << 8) | memory[(address + 1) & ADDRESS_MASK]];
+        return instr.op == OP_1NNN && instr.nnn <= address && static_cast<unsigned int>(address - instr.nnn) < 2 * IDLE_MAX_PERIOD;
+    };
+
+    if (op != OP_FX0A && op != OP_FX07 && op != OP_00FD && !jumpsBack(pc) && !jumpsBack(pc + 2)) {
+        return 0;
+    }
+
+    LoopState states[2 * IDLE_MAX_PERIOD + 1];
+    unsigned int steps = 0;
+
+    auto capture = [this](LoopState& state) {
+        std::copy(registers, registers + 16, state.registers);
+        state.indexReg = indexReg;
+        state.pc = pc;
+        state.sp = sp;
+        state.delayTimer = delayTimer;
+        state.soundTimer = soundTimer;
+        state.keyWait = keyWait;
+    };
+
+    capture(states[0]);
+
+    while (steps < cycles && steps < 2 * IDLE_MAX_PERIOD) {
+        const Instruction& instr = table[fetch()];
+
+        if (!onlyWaits(instr.op)) {
+            break;
+        }
+
+        if constexpr (PROFILING) {
+            profiler->count(pc, instr);
+        }
+
+        instructionStep();
+        handlers[instr.op](*this, instr);
+        capture(states[++steps]);
+
+        for (unsigned int period = 1; period <= IDLE_MAX_PERIOD && period <= steps; ++period) {
+            if (states[steps] == states[steps - period]) {
+                unsigned long long skipped = (cycles - steps) / period * period;
+                skippedCycles += skipped;
+                return steps + skipped;
+            }
+        }
+    }
+
+    return steps;
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::runTable(unsigned long long cycles) {
+    const Instruction* table = decodeTable();
+
+    for (unsigned long long i = 0; i < cycles; ++i) {
+        const Instruction& instr = table[fetch()];
+
+        if constexpr (PROFILING) {
+            profiler->count(pc, instr);
+        }
+
+        instructionStep();
+        handlers[instr.op](*this, instr);
+    }
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::runTraced(unsigned long long cycles) {
+    const Instruction* table = decodeTable();
+
+    for (unsigned long long i = 0; i < cycles; ++i) {
+        uint16_t address = pc;
+        uint16_t opcode = fetch();
+        const Instruction& instr = table[opcode];
+        uint8_t reg = TraceRecord::NO_REGISTER;
+
+        instructionStep();
+        handlers[instr.op](*this, instr);
+
+        switch (instr.op) {
+            case OP_6XNN: case OP_7XNN: case OP_8XY0: case OP_8XY1: case OP_8XY2:
+            case OP_8XY3: case OP_8XY4: case OP_8XY5: case OP_8XY6: case OP_8XY7:
+            case OP_8XYE: case OP_CXNN: case OP_FX07: case OP_FX0A: case OP_FX65:
+            case OP_FX85:
+                reg = instr.x;
+                break;
+            case OP_5XY3:
+                reg = instr.y;
+                break;
+            case OP_DXYN: case OP_DXY0:
+                reg = 0xF;
+                break;
+        }
+
+        tracer->record(address, opcode, indexReg, reg, reg < 16 ? registers[reg] : 0);
+    }
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::runThreaded(unsigned long long cycles) {
+#if defined(__GNUC__)
+    // Label order must match the Op enum
+    static void* const labels[OP_COUNT] = {
+        &&L_0NNN, &&L_00E0, &&L_00EE, &&L_1NNN, &&L_2NNN, &&L_3XNN, &&L_4XNN, &&L_5XY0,
+        &&L_6XNN, &&L_7XNN, &&L_8XY0, &&L_8XY1, &&L_8XY2, &&L_8XY3, &&L_8XY4, &&L_8XY5,
+        &&L_8XY6, &&L_8XY7, &&L_8XYE, &&L_9XY0, &&L_ANNN, &&L_BNNN, &&L_CXNN, &&L_DXYN,
+        &&L_EX9E, &&L_EXA1, &&L_FX07, &&L_FX0A, &&L_FX15, &&L_FX18, &&L_FX1E, &&L_FX29,
+        &&L_FX33, &&L_FX55, &&L_FX65, &&L_00CN, &&L_00FB, &&L_00FC, &&L_00FD, &&L_00FE,
+        &&L_00FF, &&L_DXY0, &&L_FX30, &&L_FX75, &&L_FX85, &&L_00DN, &&L_5XY2, &&L_5XY3,
+        &&L_F000, &&L_FN01, &&L_F002, &&L_FX3A, &&L_INVALID
+    };
+    const Instruction* table = decodeTable();
+    const Instruction* instr;
+
+    #define DISPATCH()                                        \
+        if (cycles-- == 0) return;                            \
+        instr = &table[fetch()];                              \
+        if constexpr (PROFILING) profiler->count(pc, *instr); \
+        instructionStep();                                    \
+        goto *labels[instr->op]
+
+    #define HANDLER(name)                                   \
+        L_##name: op_##name(*instr); DISPATCH()
+
+    DISPATCH();
+
+    HANDLER(0NNN); HANDLER(00E0); HANDLER(00EE); HANDLER(1NNN);
+    HANDLER(2NNN); HANDLER(3XNN); HANDLER(4XNN); HANDLER(5XY0);
+    HANDLER(6XNN); HANDLER(7XNN); HANDLER(8XY0); HANDLER(8XY1);
+    HANDLER(8XY2); HANDLER(8XY3); HANDLER(8XY4); HANDLER(8XY5);
+    HANDLER(8XY6); HANDLER(8XY7); HANDLER(8XYE); HANDLER(9XY0);
+    HANDLER(ANNN); HANDLER(BNNN); HANDLER(CXNN); HANDLER(DXYN);
+    HANDLER(EX9E); HANDLER(EXA1); HANDLER(FX07); HANDLER(FX0A);
+    HANDLER(FX15); HANDLER(FX18); HANDLER(FX1E); HANDLER(FX29);
+    HANDLER(FX33); HANDLER(FX55); HANDLER(FX65); HANDLER(00CN);
+    HANDLER(00FB); HANDLER(00FC); HANDLER(00FD); HANDLER(00FE);
+    HANDLER(00FF); HANDLER(DXY0); HANDLER(FX30); HANDLER(FX75);
+    HANDLER(FX85); HANDLER(00DN); HANDLER(5XY2); HANDLER(5XY3);
+    HANDLER(F000); HANDLER(FN01); HANDLER(F002); HANDLER(FX3A);
+    HANDLER(INVALID);
+
+    #undef HANDLER
+    #undef DISPATCH
+#else
+    runTable(cycles);
+#endif
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::runCached(unsigned long long cycles) {
+    while (cycles > 0) {
+        const Block* block = blockCache.lookup(pc, memory);
 
-        if (soundTimer == 0) {
-            std::cout << "Beep\n";
+        if (!block) {
+            cycle();
+            cycles--;
+            continue;
         }
+
+        unsigned int count = std::min<unsigned long long>(block->instrs.size(), cycles);
+        interpretBlock(block, 0, count);
+        cycles -= count;
     }
 }
 
-uint16_t Chip8::fetch() {
-    uint16_t opcode = memory[pc] << 8;
-    // instructionStep();
-    opcode |= memory[pc+1];
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::runJit(unsigned long long cycles) {
+    while (cycles > 0) {
+        Block* block = blockCache.lookup(pc, memory);
+
+        if (!block) {
+            cycle();
+            cycles--;
+            continue;
+        }
+
+        unsigned int size = block->instrs.size();
+
+        // Blocks that were ever rewritten stay interpreted
+        if (!block->native && ++block->hits == Jit::HOT_THRESHOLD
+                && !blockCache.wasInvalidated(block->start)) {
+            jit->compile(*block);
+        }
+
+        if (block->native && size <= cycles) {
+            unsigned int nativeLength = block->nativeLength;
+
+            block->native(this);
+
+            if (nativeLength < size) {
+                interpretBlock(block, nativeLength, size);
+            }
+
+            cycles -= size;
+        } else {
+            unsigned int count = std::min<unsigned long long>(size, cycles);
+            interpretBlock(block, 0, count);
+            cycles -= count;
+        }
+
+        if (jit->isFull()) {
+            blockCache.clear();
+            jit->reset();
+        }
+    }
+}
+
+// Runs instructions [first, last) of a block through the handler table
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::interpretBlock(const Block* block, unsigned int first, unsigned int last) {
+    const Instruction* instrs = block->instrs.data();
+
+    for (unsigned int i = first; i < last; ++i) {
+        // Copied, since the last instruction of a block may invalidate it
+        Instruction instr = instrs[i];
+
+        if constexpr (PROFILING) {
+            profiler->count(pc, instr);
+        }
+
+        instructionStep();
+        handlers[instr.op](*this, instr);
+    }
+}
+
+template <std::size_t MemorySize, class... Quirks>
+uint16_t Chip8Core<MemorySize, Quirks...>::fetch() {
+    uint16_t opcode = memory[pc & ADDRESS_MASK] << 8;
+    opcode |= memory[(pc+1) & ADDRESS_MASK];
     return opcode;
 }
 
-void Chip8::decodeAndExecute(unsigned short opcode) {
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::execute(const Instruction& instr) {
+    handlers[instr.op](*this, instr);
+}
+
+std::vector<uint8_t> Chip8::saveState() const {
+    std::vector<uint8_t> state(getStateSize());
+    saveState(state.data());
+    return state;
+}
+
+template <std::size_t MemorySize, class... Quirks>
+template <class Self, class Field>
+void Chip8Core<MemorySize, Quirks...>::forEachStateField(Self& chip8, Field field) {
+    field(chip8.memory);
+    field(chip8.registers);
+    field(chip8.stack);
+    field(chip8.sp);
+    field(chip8.delayTimer);
+    field(chip8.soundTimer);
+    field(chip8.indexReg);
+    field(chip8.pc);
+    field(chip8.keys);
+    field(chip8.keyWait);
+    field(chip8.display.planes);
+    field(chip8.rplFlags);
+    field(chip8.hires);
+    field(chip8.planeMask);
+    field(chip8.audioPattern);
+    field(chip8.pitch);
+    field(chip8.patternLoaded);
+    field(chip8.trapped);
+    field(chip8.trapOpcode);
+    field(chip8.trapAddress);
+    field(chip8.rng.state);
+}
+
+template <std::size_t MemorySize, class... Quirks>
+void Chip8Core<MemorySize, Quirks...>::saveState(uint8_t* state) const {
+    uint16_t version = STATE_VERSION;
+
+    state = put(state, STATE_MAGIC);
+    state = put(state, version);
+
+    forEachStateField(*this, [&state](const auto& value) {
+        state = put(state, value);
+    });
+}
+
+template <std::size_t MemorySize, class... Quirks>
+bool Chip8Core<MemorySize, Quirks...>::loadState(const uint8_t* state, std::size_t size) {
+    char magic[4];
+    uint16_t version;
+
+    if (size != getStateSize()) {
+        return false;
+    }
+
+    state = get(state, magic);
+    state = get(state, version);
+
+    if (!std::equal(magic, magic+4, STATE_MAGIC) || version != STATE_VERSION) {
+        return false;
+    }
+
+    // Snapshots can come from disk, so the fields that index arrays or are
+    // read as bools are checked in the blob before anything is loaded
+    const uint8_t* field = state;
+    bool valid = true;
+
+    forEachStateField(*this, [&](const auto& value) {
+        const void* address = &value;
+        uint8_t byte = *field;
+
+        if (address == &sp) {
+            valid = valid && byte <= 16;
+        } else if (address == &keyWait) {
+            valid = valid && (byte < 16 || byte == NO_KEY_WAIT);
+        } else if (address == &planeMask) {
+            valid = valid && byte <= Display::ALL_PLANES;
+        } else if (address == &hires || address == &patternLoaded || address == &trapped) {
+            valid = valid && byte <= 1;
+        }
+
+        field += sizeof(value);
+    });
+
+    if (!valid) {
+        return false;
+    }
+
+    bool sameMemory = std::memcmp(memory, state, sizeof(memory)) == 0;
+
+    forEachStateField(*this, [&state](auto& value) {
+        state = get(state, value);
+    });
+
+    // Cached blocks and native code are only still valid for the same memory
+    if (!sameMemory) {
+        blockCache.clear();
+
+        if (jit) {
+            jit->reset();
+        }
+    }
+
+    return true;
+}
+
+void Chip8::setKey(uint8_t key, bool pressed) {
+    key &= 0xF;
+
+    if (!pressed) {
+        keys &= ~(1 << key);
+        return;
+    }
+
+    keys |= 1 << key;
+
+    // pc is still on the FX0A
+    if (keyWait != NO_KEY_WAIT) {
+        registers[keyWait] = key;
+        keyWait = NO_KEY_WAIT;
+        instructionStep();
+    }
+}
+
+void Chip8::setKeys(uint16_t mask) {
+    keys = mask;
+}
+
+uint16_t Chip8::getKeys() const {
+    return keys;
+}
+
+void Chip8::setDispatch(Dispatch mode) {
+    // Native code can't count single instructions, so profiling builds stay
+    // interpreted. Its skips step one word and it knows no quirks, so it only
+    // runs the plain 4 KB core.
+    if (mode == Dispatch::Jit && (PROFILING || !Jit::isSupported() || isXoChip() || quirks)) {
+        mode = Dispatch::Cached;
+    }
+
+    if (mode == Dispatch::Jit && !jit) {
+        jit.reset(new Jit(*this));
+    }
+
+    dispatch = mode;
+}
+
+void Chip8::setTracer(Tracer* tracer) {
+    this->tracer = tracer;
+}
+
+void Chip8::setIdleSkip(bool enabled) {
+    idleSkip = enabled;
+}
+
+unsigned long long Chip8::getSkippedCycles() const {
+    return skippedCycles;
+}
+
+void Chip8::seed(uint64_t value) {
+    rng.seed(value);
+}
+
+// Compares everything a ROM can observe, for checking dispatch modes against each other
+template <std::size_t MemorySize, class... Quirks>
+bool Chip8Core<MemorySize, Quirks...>::sameState(const Chip8& chip8) const {
+    const Chip8Core* other = dynamic_cast<const Chip8Core*>(&chip8);
+
+    return other
+        && std::equal(memory, memory+MemorySize, other->memory)
+        && std::equal(registers, registers+16, other->registers)
+        && std::equal(stack, stack+16, other->stack)
+        && keys == other->keys
+        && keyWait == other->keyWait
+        && std::memcmp(display.planes, other->display.planes, sizeof(display.planes)) == 0
+        && std::equal(rplFlags, rplFlags+16, other->rplFlags)
+        && hires == other->hires
+        && planeMask == other->planeMask
+        && std::equal(audioPattern, audioPattern+16, other->audioPattern)
+        && pitch == other->pitch
+        && patternLoaded == other->patternLoaded
+        && sp == other->sp
+        && delayTimer == other->delayTimer
+        && soundTimer == other->soundTimer
+        && indexReg == other->indexReg
+        && pc == other->pc
+        && trapped == other->trapped;
+}
+
+bool Chip8::isSounding() const {
+    return soundTimer > 0;
+}
+
+bool Chip8::isHires() const {
+    return hires;
+}
+
+bool Chip8::isTrapped() const {
+    return trapped;
+}
+
+uint16_t Chip8::getTrapOpcode() const {
+    return trapOpcode;
+}
+
+uint16_t Chip8::getTrapAddress() const {
+    return trapAddress;
+}
+
+template <std::size_t MemorySize, class... Quirks>
+uint64_t Chip8Core<MemorySize, Quirks...>::stateHash() const {
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    auto mix = [&hash](const void* data, std::size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+        }
+    };
+
+    mix(memory, sizeof(memory));
+    mix(registers, sizeof(registers));
+    mix(stack, sizeof(stack));
+    mix(&keys, sizeof(keys));
+    mix(&keyWait, sizeof(keyWait));
+    mix(display.planes, sizeof(display.planes));
+    mix(rplFlags, sizeof(rplFlags));
+    mix(&hires, sizeof(hires));
+
+    // Left out of the 4 KB core, where they never change, so hashes match the lockstep engine's
+    if constexpr (XO_CHIP) {
+        mix(&planeMask, sizeof(planeMask));
+        mix(audioPattern, sizeof(audioPattern));
+        mix(&pitch, sizeof(pitch));
+        mix(&patternLoaded, sizeof(patternLoaded));
+    }
+
+    mix(&sp, sizeof(sp));
+    mix(&delayTimer, sizeof(delayTimer));
+    mix(&soundTimer, sizeof(soundTimer));
+    mix(&indexReg, sizeof(indexReg));
+    mix(&pc, sizeof(pc));
+    mix(&trapped, sizeof(trapped));
+    return hash;
+}
+
+const BlockCache& Chip8::getBlockCache() const {
+    return blockCache;
+}
+
+const Jit* Chip8::getJit() const {
+    return jit.get();
+}
+
+const Profiler* Chip8::getProfiler() const {
+    return profiler.get();
+}
+
+std::size_t Chip8::getMemorySize() const {
+    return memorySize;
+}
+
+bool Chip8::isXoChip() const {
+    return memorySize > 0x1000;
+}
+
+unsigned int Chip8::getQuirks() const {
+    return quirks;
+}
+
+const uint8_t* Chip8::getAudioPattern() const {
+    return patternLoaded ? audioPattern : nullptr;
+}
+
+uint8_t Chip8::getPitch() const {
+    return pitch;
+}
+
+template <std::size_t MemorySize, class... Quirks>
+std::size_t Chip8Core<MemorySize, Quirks...>::getStateSize() const {
+    std::size_t size = sizeof(STATE_MAGIC) + sizeof(STATE_VERSION);
+
+    forEachStateField(*this, [&size](const auto& value) {
+        size += sizeof(value);
+    });
+
+    return size;
+}
+
+Instruction Chip8::decode(uint16_t opcode) {
+    Instruction instr;
+    instr.x = (opcode & 0x0F00u) >> 8;
+    instr.y = (opcode & 0x00F0u) >> 4;
+    instr.n = opcode & 0x000Fu;
+    instr.nn = opcode & 0x00FFu;
+    instr.nnn = opcode & 0x0FFFu;
+    instr.op = OP_INVALID;
+
     switch ((opcode & 0xF000) >> 12) {
         case 0x0:
-            switch0Function(opcode);
-            break;
-        case 0x1:
-            op_1NNN(opcode);
-            break;
-        case 0x2:
-            op_2NNN(opcode);
-            break;
-        case 0x3:
-            op_3XNN(opcode);
-            break;
-        case 0x4:
-            op_4XNN(opcode);
+            switch (opcode) {
+                case 0x00E0: instr.op = OP_00E0; break;
+                case 0x00EE: instr.op = OP_00EE; break;
+                case 0x00FB: instr.op = OP_00FB; break;
+                case 0x00FC: instr.op = OP_00FC; break;
+                case 0x00FD: instr.op = OP_00FD; break;
+                case 0x00FE: instr.op = OP_00FE; break;
+                case 0x00FF: instr.op = OP_00FF; break;
+                default:
+                    if ((opcode & 0xFFF0) == 0x00C0) {
+                        instr.op = OP_00CN;
+                    } else if ((opcode & 0xFFF0) == 0x00D0) {
+                        instr.op = OP_00DN;
+                    } else {
+                        instr.op = OP_0NNN;
+                    }
+                    break;
+            }
             break;
+        case 0x1: instr.op = OP_1NNN; break;
+        case 0x2: instr.op = OP_2NNN; break;
+        case 0x3: instr.op = OP_3XNN; break;
+        case 0x4: instr.op = OP_4XNN; break;
         case 0x5:
-            op_5XY0(opcode);
-            break;
-        case 0x6:
-            op_6XNN(opcode);
-            break;
-        case 0x7:
-            op_7XNN(opcode);
+            switch (instr.n) {
+                case 0x0: instr.op = OP_5XY0; break;
+                case 0x2: instr.op = OP_5XY2; break;
+                case 0x3: instr.op = OP_5XY3; break;
+            }
             break;
+        case 0x6: instr.op = OP_6XNN; break;
+        case 0x7: instr.op = OP_7XNN; break;
         case 0x8:
-            switch8Function(opcode);
+            switch (instr.n) {
+                case 0x0: instr.op = OP_8XY0; break;
+                case 0x1: instr.op = OP_8XY1; break;
+                case 0x2: instr.op = OP_8XY2; break;
+                case 0x3: instr.op = OP_8XY3; break;
+                case 0x4: instr.op = OP_8XY4; break;
+                case 0x5: instr.op = OP_8XY5; break;
+                case 0x6: instr.op = OP_8XY6; break;
+                case 0x7: instr.op = OP_8XY7; break;
+                case 0xE: instr.op = OP_8XYE; break;
+            }
             break;
         case 0x9:
-            op_9XY0(opcode);
-            break;
-        case 0xA:
-            op_ANNN(opcode);
-            break;
-        case 0xB:
-            op_BNNN(opcode);
-            break;
-        case 0xC:
-            op_CXNN(opcode);
-            break;
-        case 0xD:
-            op_DXYN(opcode);
+            if (instr.n == 0x0) {
+                instr.op = OP_9XY0;
+            }
             break;
+        case 0xA: instr.op = OP_ANNN; break;
+        case 0xB: instr.op = OP_BNNN; break;
+        case 0xC: instr.op = OP_CXNN; break;
+        case 0xD: instr.op = instr.n == 0 ? OP_DXY0 : OP_DXYN; break;
         case 0xE:
-            switchEFunction(opcode);
+            switch (instr.nn) {
+                case 0x9E: instr.op = OP_EX9E; break;
+                case 0xA1: instr.op = OP_EXA1; break;
+            }
             break;
         case 0xF:
-            switchFFunction(opcode);
-            break;
-        default:
+            switch (instr.nn) {
+                case 0x00: instr.op = instr.x == 0 ? OP_F000 : OP_INVALID; break;
+                case 0x01: instr.op = OP_FN01; break;
+                case 0x02: instr.op = instr.x == 0 ? OP_F002 : OP_INVALID; break;
+                case 0x07: instr.op = OP_FX07; break;
+                case 0x0A: instr.op = OP_FX0A; break;
+                case 0x15: instr.op = OP_FX15; break;
+                case 0x18: instr.op = OP_FX18; break;
+                case 0x1E: instr.op = OP_FX1E; break;
+                case 0x29: instr.op = OP_FX29; break;
+                case 0x30: instr.op = OP_FX30; break;
+                case 0x33: instr.op = OP_FX33; break;
+                case 0x3A: instr.op = OP_FX3A; break;
+                case 0x55: instr.op = OP_FX55; break;
+                case 0x65: instr.op = OP_FX65; break;
+                case 0x75: instr.op = OP_FX75; break;
+                case 0x85: instr.op = OP_FX85; break;
+            }
             break;
     }
+
+    return instr;
 }
 
-void Chip8::switch0Function(unsigned short opcode) {
-    switch (opcode) {
-        case 0x00E0:
-            op_00E0(opcode);
-            break;
-        case 0x00EE:
-            op_00EE(opcode);
-            break;
+const char* Chip8::opName(uint8_t op) {
+    // Indexed by Op
+    static const char* const names[OP_COUNT] = {
+        "0NNN", "00E0", "00EE", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0",
+        "6XNN", "7XNN", "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5",
+        "8XY6", "8XY7", "8XYE", "9XY0", "ANNN", "BNNN", "CXNN", "DXYN",
+        "EX9E", "EXA1", "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29",
+        "FX33", "FX55", "FX65", "00CN", "00FB", "00FC", "00FD", "00FE",
+        "00FF", "DXY0", "FX30", "FX75", "FX85", "00DN", "5XY2", "5XY3",
+        "F000", "FN01", "F002", "FX3A", "invalid"
+    };
+
+    return op < OP_COUNT ? names[op] : "invalid";
+}
+
+bool Chip8::endsBlock(uint8_t op) {
+    switch (op) {
+        case OP_0NNN: case OP_00EE: case OP_1NNN: case OP_2NNN:
+        case OP_3XNN: case OP_4XNN: case OP_5XY0: case OP_9XY0:
+        case OP_BNNN: case OP_EX9E: case OP_EXA1: case OP_FX0A:
+        case OP_FX33: case OP_FX55: case OP_00FD: case OP_00DN:
+        case OP_5XY2: case OP_5XY3: case OP_F000: case OP_FN01:
+        case OP_F002: case OP_FX3A: case OP_INVALID:
+            return true;
         default:
-            op_0NNN(opcode);
-            break;
+            return false;
     }
 }
 
-void Chip8::switch8Function(unsigned short opcode) {
-    unsigned char lastHex = opcode & 0x000F;
+const Instruction* Chip8::decodeTable() {
+    static const std::vector<Instruction> table = [] {
+        std::vector<Instruction> decoded(0x10000);
 
-    switch (lastHex) {
-        case 0x0:
-            op_8XY0(opcode);
-            break;
-        case 0x1:
-            op_8XY1(opcode);
-            break;
-        case 0x2:
-            op_8XY2(opcode);
-            break;
-        case 0x3:
-            op_8XY3(opcode);
-            break;
-        case 0x4:
-            op_8XY4(opcode);
-            break;
-        case 0x5:
-            op_8XY5(opcode);
-            break;
-        case 0x6:
-            op_8XY6(opcode);
-            break;
-        case 0x7:
-            op_8XY7(opcode);
-            break;
-        case 0xE:
-            op_8XYE(opcode);
-            break;
-    }
-}
+        for (unsigned int opcode = 0; opcode < 0x10000; ++opcode) {
+            decoded[opcode] = decode(opcode);
+        }
 
-void Chip8::switchEFunction(unsigned short opcode) {
-    unsigned char lastHex = opcode & 0x000F;
+        return decoded;
+    }();
 
-    switch (lastHex) {
-        case 0xE:
-            op_EX9E(opcode);
-            break;
-        case 0x1:
-            op_EXA1(opcode);
-            break;
-    }
+    return table.data();
 }
 
-void Chip8::switchFFunction(unsigned short opcode) {
-    unsigned char lastChar = opcode & 0x00FF;
-
-    switch (lastChar) {
-        case 0x07:
-            op_FX07(opcode);
-            break;
-        case 0x0A:
-            op_FX0A(opcode);
-            break;
-        case 0x15:
-            op_FX15(opcode);
-            break;
-        case 0x18:
-            op_FX18(opcode);
-            break;
-        case 0x1E:
-            op_FX1E(opcode);
-            break;
-        case 0x29:
-            op_FX29(opcode);
-            break;
-        case 0x33:
-            op_FX33(opcode);
-            break;
-        case 0x55:
-            op_FX55(opcode);
-            break;
-        case 0x65:
-            op_FX65(opcode);
-            break;
-    }
-}
\ No newline at end of file
+template class Chip8Core<0x1000>;
+template class Chip8Core<0x1000, QuirkShiftVY, QuirkIncrementI>;
+template class Chip8Core<0x1000, QuirkJumpVX>;
+template class Chip8Core<0x1000, QuirkShiftVY, QuirkIncrementI, QuirkWrapSprites>;
+template class Chip8Core<0x10000>;
+template class Chip8Core<0x10000, QuirkShiftVY, QuirkIncrementI>;
+template class Chip8Core<0x10000, QuirkJumpVX>;
+template class Chip8Core<0x10000, QuirkShiftVY, QuirkIncrementI, QuirkWrapSprites>;
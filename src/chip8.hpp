@@ -1,14 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
 #include <iostream>
-#include <windows.h>
 #include <iomanip>
 #include <array>
+#include <vector>
 #include <fstream>
 #include <chrono>
-#include <random>
+#include <memory>
+#include <cstring>
+#include <type_traits>
+#include <bitset>
+#include "instruction.hpp"
+#include "blockcache.hpp"
+#include "display.hpp"
+#include "quirks.hpp"
+#include "romimage.hpp"
+#include "xorshift.hpp"
+
+#ifndef CHIP8_PROFILE
+    #define CHIP8_PROFILE 0
+#endif
+
+class Jit;
+class Profiler;
+class Tracer;
 
+// CHIP-8 and SUPER-CHIP, plus XO-CHIP in the 64 KB core. The machine is a
+// Chip8Core instantiated for the size of its address space and its quirks;
+// this base holds everything that doesn't depend on them, so frontends and
+// tools can drive every core through one interface. Chip8::create() picks
+// the core.
 class Chip8 {
-    private:
-        uint8_t memory[4096];       // Memory of 4096 8-bit addresses
+    public:
+        // Handler table indices, one per instruction
+        enum Op : uint8_t {
+            OP_0NNN, OP_00E0, OP_00EE, OP_1NNN, OP_2NNN, OP_3XNN, OP_4XNN, OP_5XY0,
+            OP_6XNN, OP_7XNN, OP_8XY0, OP_8XY1, OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5,
+            OP_8XY6, OP_8XY7, OP_8XYE, OP_9XY0, OP_ANNN, OP_BNNN, OP_CXNN, OP_DXYN,
+            OP_EX9E, OP_EXA1, OP_FX07, OP_FX0A, OP_FX15, OP_FX18, OP_FX1E, OP_FX29,
+            OP_FX33, OP_FX55, OP_FX65, OP_00CN, OP_00FB, OP_00FC, OP_00FD, OP_00FE,
+            OP_00FF, OP_DXY0, OP_FX30, OP_FX75, OP_FX85, OP_00DN, OP_5XY2, OP_5XY3,
+            OP_F000, OP_FN01, OP_F002, OP_FX3A, OP_INVALID,
+            OP_COUNT
+        };
+
+        // How run() dispatches instructions
+        enum class Dispatch {
+            Table,      // Indirect call through the handler table
+            Threaded,   // Computed goto, falls back to Table without GCC/Clang
+            Cached,     // Pre-decoded basic blocks from the block cache
+            Jit         // Hot blocks compiled to native code, falls back to Cached where unsupported
+        };
+
+    protected:
+        friend class Jit;
+        friend class LockstepEngine;
+
         uint8_t registers[16];      // 16 8-bit Registers
         uint16_t stack[16];         // Stack
         uint8_t sp;                 // Stack pointer
@@ -16,68 +65,264 @@ class Chip8 {
         uint8_t soundTimer;         // Sound timer
         uint16_t indexReg;
         uint16_t pc;
-        std::default_random_engine rng;
-        std::uniform_int_distribution<uint8_t> rand;
+        uint16_t keys;              // Bit N set while key N is down
+        uint8_t keyWait;            // Register FX0A is waiting to load a key into, or NO_KEY_WAIT
+        bool hires;                 // SCHIP 128x64 mode, switched by 00FF and 00FE
+        uint8_t rplFlags[16];       // SCHIP flag registers, saved by FX75 and loaded by FX85
+        uint8_t planeMask;          // XO-CHIP bitplanes drawn, cleared and scrolled, selected by FN01
+        uint8_t audioPattern[16];   // XO-CHIP 1-bit sample pattern, loaded by F002
+        uint8_t pitch;              // XO-CHIP pattern playback rate, set by FX3A
+        bool patternLoaded;         // Whether F002 has run, until then the tone is the plain beep
+        Xorshift rng;
         static const std::array<uint8_t, 80> fontset;
+        static const std::array<uint8_t, 160> bigFontset;   // SCHIP 8x10 digits, loaded after fontset
+
+        const std::size_t memorySize;
+        const unsigned int quirks;  // BIT of each quirk the core has
+        Dispatch dispatch;
+        bool trapped;               // Set when an invalid opcode was executed
+        uint16_t trapOpcode;
+        uint16_t trapAddress;
+        BlockCache blockCache;
+        std::unique_ptr<Jit> jit;
+        std::unique_ptr<Profiler> profiler;     // Only allocated when PROFILING
+        Tracer* tracer;
+        bool idleSkip;
+        unsigned long long skippedCycles;
+
+        Chip8(std::size_t memorySize, unsigned int quirks);
 
     public:
-        bool keyPressedState[16];   // Keys for input
-        uint32_t display[2048];     // Display of 64x32 pixels
-        
-        Chip8();
-        ~Chip8();
-
-        void loadROM(char const* filename);
-        void printMemory();
+        static const uint16_t STATE_VERSION = 5;
+        static constexpr uint8_t NO_KEY_WAIT = 0xFF;
+        static const unsigned int IDLE_MAX_PERIOD = 8;              // Longest wait loop detected, in instructions
+        static const unsigned long long IDLE_CHECK_INTERVAL = 4096; // Cycles between checks for a wait loop
+        static const uint8_t DEFAULT_PITCH = 64;                    // FX3A value playing the pattern at 4000 Hz
+
+        // Set by the CHIP8_PROFILE CMake option. Every profiling hook is behind
+        // if constexpr on this, so normal builds carry none of them.
+        static constexpr bool PROFILING = CHIP8_PROFILE;
+
+        Display display;            // 64x32 pixels, or 128x64 in SCHIP hi-res mode
+
+        // A CHIP-8 and SUPER-CHIP machine with 4 KB of memory, or with xoChip
+        // an XO-CHIP one with 64 KB, behaving as the interpreters of profile do
+        static std::unique_ptr<Chip8> create(bool xoChip = false, QuirkProfile profile = QuirkProfile::Default);
+
+        virtual ~Chip8();
+
+        // Copies a ROM to 0x200. False, leaving memory alone, if the file
+        // can't be read or the ROM doesn't fit.
+        bool loadROM(char const* filename);
+        virtual bool loadROM(const RomImage& rom) = 0;
+        virtual void printMemory() = 0;
         void printRegisters();
         void printDisplay();
 
+        // Unchecked; op_2NNN and op_00EE trap before sp leaves 0..16
         unsigned short popFromStack();
         void pushToStack(unsigned short address);
 
-        void op_0NNN(unsigned short opcode);
-        void op_00E0(unsigned short opcode);
-        void op_00EE(unsigned short opcode);
-        void op_1NNN(unsigned short opcode);
-        void op_2NNN(unsigned short opcode);
-        void op_3XNN(unsigned short opcode);
-        void op_4XNN(unsigned short opcode);
-        void op_5XY0(unsigned short opcode);
-        void op_6XNN(unsigned short opcode);
-        void op_7XNN(unsigned short opcode);
-        void op_8XY0(unsigned short opcode);
-        void op_8XY1(unsigned short opcode);
-        void op_8XY2(unsigned short opcode);
-        void op_8XY3(unsigned short opcode);
-        void op_8XY4(unsigned short opcode);
-        void op_8XY5(unsigned short opcode);
-        void op_8XY6(unsigned short opcode);
-        void op_8XY7(unsigned short opcode);
-        void op_8XYE(unsigned short opcode);
-        void op_9XY0(unsigned short opcode);
-        void op_ANNN(unsigned short opcode);
-        void op_BNNN(unsigned short opcode);
-        void op_CXNN(unsigned short opcode);
-        void op_DXYN(unsigned short opcode);
-        void op_EX9E(unsigned short opcode);
-        void op_EXA1(unsigned short opcode);
-        void op_FX07(unsigned short opcode);
-        void op_FX0A(unsigned short opcode);
-        void op_FX15(unsigned short opcode);
-        void op_FX18(unsigned short opcode);
-        void op_FX1E(unsigned short opcode);
-        void op_FX29(unsigned short opcode);
-        void op_FX33(unsigned short opcode);
-        void op_FX55(unsigned short opcode);
-        void op_FX65(unsigned short opcode);
-
         void instructionStep();
+        virtual void run(unsigned long long cycles) = 0;
+        void tickTimers();          // Called at 60 Hz, independent of the instruction rate
+
+        // Snapshot of the whole machine, RNG included, in a versioned binary
+        // format of getStateSize() bytes. Multi-byte fields are in host byte
+        // order. A snapshot only loads into a core with the same memory size.
+        std::vector<uint8_t> saveState() const;
+        virtual void saveState(uint8_t* state) const = 0;
+        virtual bool loadState(const uint8_t* state, std::size_t size) = 0;    // False if the format or version doesn't match
+        virtual std::size_t getStateSize() const = 0;
+
+        // Key event from the frontend. A press while FX0A waits hands that key
+        // straight to FX0A and resumes after it, instead of FX0A polling.
+        void setKey(uint8_t key, bool pressed);
+        void setKeys(uint16_t mask);    // Sets every key at once, without waking FX0A
+        uint16_t getKeys() const;       // Bit N set while key N is down
+
+        void setDispatch(Dispatch mode);
+
+        // Lets run() skip the rest of its cycles once the machine spins in a
+        // wait loop, such as FX0A with no key down, a jump to itself or a
+        // loop polling the delay timer. Nothing outside run() changes during
+        // a call, so the machine ends in exactly the state it would have
+        // reached by running every cycle. On by default.
+        void setIdleSkip(bool enabled);
+        unsigned long long getSkippedCycles() const;
+
+        // Records every instruction run() executes; null stops tracing. Traced
+        // runs use the table interpreter whatever the dispatch mode.
+        void setTracer(Tracer* tracer);
+        void seed(uint64_t value);      // Same seed and inputs give the same run; unseeded machines seed from the clock
+        virtual bool sameState(const Chip8& other) const = 0;
+        virtual uint64_t stateHash() const = 0;     // FNV-1a over the same state sameState() compares
+        bool isSounding() const;        // The tone plays while the sound timer is non-zero
+        bool isHires() const;           // In SCHIP 128x64 mode
+        bool isTrapped() const;
+        uint16_t getTrapOpcode() const;
+        uint16_t getTrapAddress() const;
+        std::size_t getMemorySize() const;
+        bool isXoChip() const;
+        unsigned int getQuirks() const;         // BIT of each quirk the core has
+
+        // The 16-byte XO-CHIP sound pattern, null until F002 loads one, and
+        // the FX3A pitch it plays at
+        const uint8_t* getAudioPattern() const;
+        uint8_t getPitch() const;
+
+        const BlockCache& getBlockCache() const;
+        const Jit* getJit() const;
+        const Profiler* getProfiler() const;    // Null unless PROFILING
+
+        // Decodes an opcode; the 64K-entry table of every decoded opcode is built once
+        static Instruction decode(uint16_t opcode);
+        static const Instruction* decodeTable();
+
+        // Name of an Op, like "8XY4"
+        static const char* opName(uint8_t op);
+
+        // True for instructions that can leave straight-line flow or write
+        // memory, including the XO-CHIP ones, which trap in the 4 KB core
+        static bool endsBlock(uint8_t op);
+};
+
+// The interpreter for an address space of MemorySize bytes, a power of two.
+// Every address is masked to it, so the 4 KB core keeps the footprint and
+// behaviour of plain CHIP-8, and XO-CHIP instructions trap there. The 64 KB
+// core adds them: F000 NNNN loads a 16-bit I, skips step over it as one
+// instruction, and draws, clears and scrolls apply to the FN01 planes.
+// Quirks are the tags from quirks.hpp, resolved at compile time.
+// Definitions live in chip8.cpp, which instantiates a core for each memory
+// size and quirk profile.
+template <std::size_t MemorySize, class... Quirks>
+class Chip8Core : public Chip8 {
+    public:
+        static const unsigned int ADDRESS_MASK = MemorySize - 1;
+        static constexpr bool XO_CHIP = MemorySize > 0x1000;
+        static constexpr bool SHIFT_VY = hasQuirk<QuirkShiftVY, Quirks...>;
+        static constexpr bool INCREMENT_I = hasQuirk<QuirkIncrementI, Quirks...>;
+        static constexpr bool JUMP_VX = hasQuirk<QuirkJumpVX, Quirks...>;
+        static constexpr bool WRAP_SPRITES = hasQuirk<QuirkWrapSprites, Quirks...>;
+
+        static_assert((MemorySize & ADDRESS_MASK) == 0 && MemorySize >= 0x1000 && MemorySize <= 0x10000,
+                      "Memory is a power of two between 4 KB and the 16-bit address space");
+
+    protected:
+        uint8_t memory[MemorySize];
+
+    private:
+        typedef void (*Handler)(Chip8Core& chip8, const Instruction& instr);
+        static const Handler handlers[OP_COUNT];
+
+        // Adapts an op_XXXX member into a plain function pointer for the handler table
+        template <void (Chip8Core::*Op)(const Instruction&)>
+        static void handler(Chip8Core& chip8, const Instruction& instr) {
+            (chip8.*Op)(instr);
+        }
+
+        // Calls field() on each piece of state, in snapshot order. saveState(),
+        // loadState() and getStateSize() all walk this one list.
+        template <class Self, class Field>
+        static void forEachStateField(Self& chip8, Field field);
+
+        void runDispatch(unsigned long long cycles);
+        unsigned long long skipIdleLoop(unsigned long long cycles);
+        void runTable(unsigned long long cycles);
+        void runThreaded(unsigned long long cycles);
+        void runCached(unsigned long long cycles);
+        void runJit(unsigned long long cycles);
+        void runTraced(unsigned long long cycles);
+        void interpretBlock(const Block* block, unsigned int first, unsigned int last);
+
+        // Steps over the next instruction, which is two words for F000 NNNN
+        void skipInstruction();
+
+        // Planes the display instructions apply to; only XO-CHIP selects any but the first
+        unsigned int selectedPlanes() const {
+            return XO_CHIP ? planeMask : 1;
+        }
+
+    public:
+        Chip8Core();
+
+        using Chip8::loadROM;
+        bool loadROM(const RomImage& rom) override;
+        void printMemory() override;
+
+        void op_0NNN(const Instruction& instr);
+        void op_00E0(const Instruction& instr);
+        void op_00EE(const Instruction& instr);
+        void op_1NNN(const Instruction& instr);
+        void op_2NNN(const Instruction& instr);
+        void op_3XNN(const Instruction& instr);
+        void op_4XNN(const Instruction& instr);
+        void op_5XY0(const Instruction& instr);
+        void op_6XNN(const Instruction& instr);
+        void op_7XNN(const Instruction& instr);
+        void op_8XY0(const Instruction& instr);
+        void op_8XY1(const Instruction& instr);
+        void op_8XY2(const Instruction& instr);
+        void op_8XY3(const Instruction& instr);
+        void op_8XY4(const Instruction& instr);
+        void op_8XY5(const Instruction& instr);
+        void op_8XY6(const Instruction& instr);
+        void op_8XY7(const Instruction& instr);
+        void op_8XYE(const Instruction& instr);
+        void op_9XY0(const Instruction& instr);
+        void op_ANNN(const Instruction& instr);
+        void op_BNNN(const Instruction& instr);
+        void op_CXNN(const Instruction& instr);
+        void op_DXYN(const Instruction& instr);
+        void op_EX9E(const Instruction& instr);
+        void op_EXA1(const Instruction& instr);
+        void op_FX07(const Instruction& instr);
+        void op_FX0A(const Instruction& instr);
+        void op_FX15(const Instruction& instr);
+        void op_FX18(const Instruction& instr);
+        void op_FX1E(const Instruction& instr);
+        void op_FX29(const Instruction& instr);
+        void op_FX33(const Instruction& instr);
+        void op_FX55(const Instruction& instr);
+        void op_FX65(const Instruction& instr);
+        void op_00CN(const Instruction& instr);
+        void op_00FB(const Instruction& instr);
+        void op_00FC(const Instruction& instr);
+        void op_00FD(const Instruction& instr);
+        void op_00FE(const Instruction& instr);
+        void op_00FF(const Instruction& instr);
+        void op_DXY0(const Instruction& instr);
+        void op_FX30(const Instruction& instr);
+        void op_FX75(const Instruction& instr);
+        void op_FX85(const Instruction& instr);
+        void op_00DN(const Instruction& instr);
+        void op_5XY2(const Instruction& instr);
+        void op_5XY3(const Instruction& instr);
+        void op_F000(const Instruction& instr);
+        void op_FN01(const Instruction& instr);
+        void op_F002(const Instruction& instr);
+        void op_FX3A(const Instruction& instr);
+        void op_INVALID(const Instruction& instr);
+
         void cycle();
+        void run(unsigned long long cycles) override;
         uint16_t fetch();
-        void decodeAndExecute(unsigned short opcode);
+        void execute(const Instruction& instr);
+
+        using Chip8::saveState;
+        void saveState(uint8_t* state) const override;
+        bool loadState(const uint8_t* state, std::size_t size) override;
+        std::size_t getStateSize() const override;
+        bool sameState(const Chip8& other) const override;
+        uint64_t stateHash() const override;
+};
 
-        void switch0Function(unsigned short opcode);
-        void switch8Function(unsigned short opcode);
-        void switchEFunction(unsigned short opcode);
-        void switchFFunction(unsigned short opcode);
-};
\ No newline at end of file
+// One core per quirk profile, as Chip8::create() picks them
+extern template class Chip8Core<0x1000>;
+extern template class Chip8Core<0x1000, QuirkShiftVY, QuirkIncrementI>;
+extern template class Chip8Core<0x1000, QuirkJumpVX>;
+extern template class Chip8Core<0x1000, QuirkShiftVY, QuirkIncrementI, QuirkWrapSprites>;
+extern template class Chip8Core<0x10000>;
+extern template class Chip8Core<0x10000, QuirkShiftVY, QuirkIncrementI>;
+extern template class Chip8Core<0x10000, QuirkJumpVX>;
+extern template class Chip8Core<0x10000, QuirkShiftVY, QuirkIncrementI, QuirkWrapSprites>;
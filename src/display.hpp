@@ -0,0 +1,251 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+
+// 1-bit framebuffers of 128x64 pixels, one per XO-CHIP bitplane, two words
+// per row, with the leftmost pixel in the top bit of the first word. The
+// 64x32 low resolution uses only the first word of the top 32 rows, so a
+// CHIP-8 sprite row still lands in a single word. Everything else stays zero
+// while in low resolution. CHIP-8 and SUPER-CHIP only ever select plane 0.
+//
+// Drawing and scrolling work on whole words: a sprite row is shifted into
+// place and XORed over at most two words, and a scroll moves or shifts rows
+// of words, never single pixels. Each takes a mask of the planes it applies
+// to, bit N for plane N.
+struct Display {
+    // What a draw covered, summed over the planes it drew on, for the profiler
+    struct DrawStats {
+        unsigned int rows;          // Sprite rows drawn, after clipping
+        unsigned int pixels;        // Lit sprite pixels XORed onto the display
+    };
+
+    static const unsigned int WIDTH = 128;
+    static const unsigned int HEIGHT = 64;
+    static const unsigned int WORDS = 2;            // Per row
+    static const unsigned int PLANES = 2;
+    static const unsigned int ALL_PLANES = (1 << PLANES) - 1;
+    static const unsigned int LORES_WIDTH = 64;
+    static const unsigned int LORES_HEIGHT = 32;
+
+    typedef uint64_t Plane[HEIGHT][WORDS];
+
+    Plane planes[PLANES];
+
+    static unsigned int width(bool hires) {
+        return hires ? WIDTH : LORES_WIDTH;
+    }
+
+    static unsigned int height(bool hires) {
+        return hires ? HEIGHT : LORES_HEIGHT;
+    }
+
+    void clear(unsigned int planeMask = ALL_PLANES) {
+        for (unsigned int plane = 0; plane < PLANES; ++plane) {
+            if (planeMask & (1 << plane)) {
+                std::memset(planes[plane], 0, sizeof(Plane));
+            }
+        }
+    }
+
+    // XORs a sprite of spriteRows rows onto each plane in planeMask, reading
+    // it from memory at address with every address masked. Rows are one byte,
+    // or two with wide for the 16x16 sprites, and each selected plane takes
+    // the next whole sprite. The start position wraps; the sprite itself is
+    // clipped at the right and bottom edges, or wraps around them with Wrap.
+    // Adds what it drew to stats if given, and returns whether a lit pixel
+    // was turned off on any plane.
+    template <bool Wrap = false>
+    bool draw(unsigned int planeMask, bool hires, unsigned int x, unsigned int y, const uint8_t* memory,
+              unsigned int address, unsigned int addressMask, unsigned int spriteRows, bool wide,
+              DrawStats* stats = nullptr) {
+        unsigned int spriteBytes = wide ? 2 * spriteRows : spriteRows;
+        bool collision = false;
+
+        // Both resolutions are powers of two, so wrapping is a mask
+        x &= width(hires) - 1;
+        y &= height(hires) - 1;
+        if constexpr (!Wrap) {
+            spriteRows = spriteRows < height(hires) - y ? spriteRows : height(hires) - y;
+        }
+
+        for (unsigned int plane = 0; plane < PLANES; ++plane) {
+            if (!(planeMask & (1 << plane))) {
+                continue;
+            }
+
+            // One loop per case, so a CHIP-8 sprite touches one word per row as before
+            Plane& rows = planes[plane];
+
+            if (stats) {
+                stats->rows += spriteRows;
+            }
+
+            if (hires) {
+                collision |= wide ? drawRows<true, true, Wrap>(rows, x, y, memory, address, addressMask, spriteRows, stats)
+                                  : drawRows<false, true, Wrap>(rows, x, y, memory, address, addressMask, spriteRows, stats);
+            } else {
+                collision |= wide ? drawRows<true, false, Wrap>(rows, x, y, memory, address, addressMask, spriteRows, stats)
+                                  : drawRows<false, false, Wrap>(rows, x, y, memory, address, addressMask, spriteRows, stats);
+            }
+
+            address += spriteBytes;
+        }
+
+        return collision;
+    }
+
+    // Moves every row down by count rows, blanking the ones scrolled in at the top
+    void scrollDown(unsigned int planeMask, bool hires, unsigned int count) {
+        unsigned int rowCount = height(hires);
+
+        count = count < rowCount ? count : rowCount;
+
+        for (unsigned int plane = 0; plane < PLANES; ++plane) {
+            if (planeMask & (1 << plane)) {
+                std::memmove(planes[plane][count], planes[plane][0], (rowCount - count) * sizeof(planes[plane][0]));
+                std::memset(planes[plane][0], 0, count * sizeof(planes[plane][0]));
+            }
+        }
+    }
+
+    // Moves every row up by count rows, blanking the ones scrolled in at the bottom
+    void scrollUp(unsigned int planeMask, bool hires, unsigned int count) {
+        unsigned int rowCount = height(hires);
+
+        count = count < rowCount ? count : rowCount;
+
+        for (unsigned int plane = 0; plane < PLANES; ++plane) {
+            if (planeMask & (1 << plane)) {
+                std::memmove(planes[plane][0], planes[plane][count], (rowCount - count) * sizeof(planes[plane][0]));
+                std::memset(planes[plane][rowCount - count], 0, count * sizeof(planes[plane][0]));
+            }
+        }
+    }
+
+    // Scrolls 4 pixels right, one 128-bit shift across the two words of each row
+    void scrollRight(unsigned int planeMask, bool hires) {
+        unsigned int rowCount = height(hires);
+        uint64_t spillMask = hires ? ~0ull : 0;
+
+        for (unsigned int plane = 0; plane < PLANES; ++plane) {
+            if (!(planeMask & (1 << plane))) {
+                continue;
+            }
+
+            for (unsigned int row = 0; row < rowCount; ++row) {
+                uint64_t* line = planes[plane][row];
+
+                line[1] = ((line[1] >> 4) | (line[0] << 60)) & spillMask;
+                line[0] >>= 4;
+            }
+        }
+    }
+
+    // Scrolls 4 pixels left. The second word is all zero in low resolution,
+    // so the same shift serves both.
+    void scrollLeft(unsigned int planeMask, bool hires) {
+        unsigned int rowCount = height(hires);
+
+        for (unsigned int plane = 0; plane < PLANES; ++plane) {
+            if (!(planeMask & (1 << plane))) {
+                continue;
+            }
+
+            for (unsigned int row = 0; row < rowCount; ++row) {
+                uint64_t* line = planes[plane][row];
+
+                line[0] = (line[0] << 4) | (line[1] >> 60);
+                line[1] <<= 4;
+            }
+        }
+    }
+
+    // Expands rows [firstRow, firstRow + rowCount) of a WIDTH x HEIGHT image to
+    // 32-bit RGBA pixels. Plane 0 alone is white as CHIP-8 has always been,
+    // the other combinations are greys. In low resolution every pixel covers
+    // 2x2 of the image. pixels points at firstRow and pitch is in bytes.
+    void expand(bool hires, uint32_t* pixels, int pitch, unsigned int firstRow, unsigned int rowCount) const {
+        static const uint32_t palette[1 << PLANES] = { 0x00000000, 0xFFFFFFFF, 0x555555FF, 0xAAAAAAFF };
+
+        for (unsigned int row = 0; row < rowCount; ++row) {
+            uint32_t* line = reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(pixels) + row * pitch);
+            unsigned int source = hires ? firstRow + row : (firstRow + row) / 2;
+
+            for (unsigned int col = 0; col < WIDTH; ++col) {
+                unsigned int bit = hires ? col : col / 2;
+                unsigned int color = 0;
+
+                for (unsigned int plane = 0; plane < PLANES; ++plane) {
+                    color |= ((planes[plane][source][bit / 64] >> (63 - bit % 64)) & 1) << plane;
+                }
+
+                line[col] = palette[color];
+            }
+        }
+    }
+
+    // Whether row differs from the same row of other on any plane
+    bool rowDiffers(const Display& other, unsigned int row) const {
+        for (unsigned int plane = 0; plane < PLANES; ++plane) {
+            if (planes[plane][row][0] != other.planes[plane][row][0] || planes[plane][row][1] != other.planes[plane][row][1]) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static uint64_t allRows(unsigned int rowCount) {
+        return rowCount == 64 ? ~0ull : (1ull << rowCount) - 1;
+    }
+
+    // In high resolution, a row starting in the first word spills what is
+    // shifted out of it into the second; past the first word, the whole row
+    // goes into the second. Low resolution ends with the first word. With
+    // Wrap, what falls off the right edge comes back in at the left, and rows
+    // past the bottom at the top.
+    template <bool Wide, bool Hires, bool Wrap>
+    static bool drawRows(Plane& rows, unsigned int x, unsigned int y, const uint8_t* memory, unsigned int address,
+                         unsigned int addressMask, unsigned int spriteRows, DrawStats* stats) {
+        unsigned int word = Hires ? x / 64 : 0;
+        unsigned int shift = x % 64;
+        uint64_t collision = 0;
+
+        for (unsigned int row = 0; row < spriteRows; ++row) {
+            uint64_t bits;
+
+            if constexpr (Wide) {
+                bits = static_cast<uint64_t>(memory[(address + 2 * row) & addressMask]) << 56
+                     | static_cast<uint64_t>(memory[(address + 2 * row + 1) & addressMask]) << 48;
+            } else {
+                bits = static_cast<uint64_t>(memory[(address + row) & addressMask]) << 56;
+            }
+
+            uint64_t first = bits >> shift;
+            uint64_t spill = 0;
+            unsigned int lineRow = Wrap ? (y + row) & (height(Hires) - 1) : y + row;
+            uint64_t* line = rows[lineRow];
+
+            if constexpr (Wrap && !Hires) {
+                first |= bits << (63 - shift) << 1;
+            }
+
+            collision |= line[word] & first;
+            line[word] ^= first;
+
+            if constexpr (Hires) {
+                spill = Wrap || word == 0 ? bits << (63 - shift) << 1 : 0;
+                collision |= line[word ^ 1] & spill;
+                line[word ^ 1] ^= spill;
+            }
+
+            if (stats) {
+                stats->pixels += std::bitset<64>(first).count() + std::bitset<64>(spill).count();
+            }
+        }
+
+        return collision != 0;
+    }
+};
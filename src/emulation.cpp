@@ -0,0 +1,167 @@
+#include "emulation.hpp"
+#include <vector>
+
+EmulationThread::EmulationThread(Chip8& chip8, unsigned int instructionsPerSecond)
+    : chip8(chip8), scheduler(chip8, instructionsPerSecond), recording(nullptr), sound(nullptr), input(INPUT_QUEUE_SIZE),
+      running(false), rewinding(false), trapped(false), presentTime(0), presentPeriod(0), inputCount(0), inputLatencyTotal(), inputLatencyMax() {
+}
+
+EmulationThread::~EmulationThread() {
+    stop();
+}
+
+void EmulationThread::setRecording(InputRecording* recording) {
+    this->recording = recording;
+}
+
+void EmulationThread::setSoundChannel(SoundChannel* sound) {
+    this->sound = sound;
+}
+
+void EmulationThread::start() {
+    running = true;
+    thread = std::thread(&EmulationThread::loop, this);
+}
+
+void EmulationThread::stop() {
+    running = false;
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    if (sound) {
+        sound->setGate(false);
+    }
+}
+
+bool EmulationThread::pushKey(const KeyEvent& event) {
+    return input.tryPush(event);
+}
+
+void EmulationThread::setRewinding(bool rewinding) {
+    this->rewinding.store(rewinding, std::memory_order_relaxed);
+}
+
+void EmulationThread::alignFrames(std::chrono::steady_clock::time_point present, std::chrono::steady_clock::duration period) {
+    presentTime.store(present.time_since_epoch().count(), std::memory_order_relaxed);
+    presentPeriod.store(period.count(), std::memory_order_relaxed);
+}
+
+bool EmulationThread::updateFrame() {
+    return frames.update();
+}
+
+const EmulationThread::Frame& EmulationThread::getFrame() const {
+    return frames.readBuffer();
+}
+
+bool EmulationThread::hasTrapped() const {
+    return trapped;
+}
+
+unsigned long long EmulationThread::getCycleCount() const {
+    return scheduler.getCycleCount();
+}
+
+unsigned long long EmulationThread::getInputCount() const {
+    return inputCount;
+}
+
+std::chrono::steady_clock::duration EmulationThread::getInputLatencyTotal() const {
+    return inputLatencyTotal;
+}
+
+std::chrono::steady_clock::duration EmulationThread::getInputLatencyMax() const {
+    return inputLatencyMax;
+}
+
+void EmulationThread::loop() {
+    std::vector<std::chrono::steady_clock::time_point> eventTimes;
+    unsigned long long frameNumber = 0;
+
+    while (running) {
+        const KeyEvent* events;
+        std::size_t count;
+
+        // Keys apply at the start of the frame, where the single-threaded loop polled them
+        while ((count = input.peek(events)) > 0) {
+            for (std::size_t i = 0; i < count; ++i) {
+                chip8.setKey(events[i].key, events[i].pressed);
+                eventTimes.push_back(events[i].time);
+
+                if (recording) {
+                    recording->record(scheduler.getCycleCount(), events[i].key, events[i].pressed);
+                }
+            }
+
+            input.consume(count);
+        }
+
+        if (rewinding.load(std::memory_order_relaxed) && !recording) {
+            // Step back a frame per frame, keeping the keys as they are physically held
+            uint16_t keys = chip8.getKeys();
+            rewind.stepBack(chip8);
+            chip8.setKeys(keys);
+        } else {
+            scheduler.runFrame();
+            rewind.push(chip8);
+        }
+
+        if (sound) {
+            sound->setGate(chip8.isSounding());
+
+            if (chip8.getAudioPattern()) {
+                sound->setPattern(chip8.getAudioPattern(), chip8.getPitch());
+            }
+        }
+
+        Frame& frame = frames.writeBuffer();
+        auto now = std::chrono::steady_clock::now();
+        frame.display = chip8.display;
+        frame.hires = chip8.isHires();
+        frame.number = frameNumber++;
+        frame.time = now;
+        frames.publish();
+
+        for (std::chrono::steady_clock::time_point time : eventTimes) {
+            inputLatencyTotal += now - time;
+            inputLatencyMax = std::max(inputLatencyMax, now - time);
+            inputCount++;
+        }
+
+        eventTimes.clear();
+
+        if (chip8.isTrapped()) {
+            trapped = true;
+            break;
+        }
+
+        alignToDisplay();
+        scheduler.waitForNextFrame();
+    }
+}
+
+// Moves the next deadline a fraction of the way to the middle of a refresh
+// interval. Small steps keep frame times even while following a display that
+// runs slightly off 60 Hz.
+void EmulationThread::alignToDisplay() {
+    typedef std::chrono::steady_clock Clock;
+    Clock::duration period(presentPeriod.load(std::memory_order_relaxed));
+
+    if (period == Clock::duration::zero()) {
+        return;
+    }
+
+    Clock::time_point present(Clock::duration(presentTime.load(std::memory_order_relaxed)));
+    Clock::duration error = (present + period / 2 - scheduler.getNextFrame()) % period;
+
+    // Shortest way round, within half a period either side
+    if (error > period / 2) {
+        error -= period;
+    } else if (error < -period / 2) {
+        error += period;
+    }
+
+    scheduler.shiftNextFrame(error / ALIGN_STEPS);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "chip8.hpp"
+#include "scheduler.hpp"
+#include "rewind.hpp"
+#include "recording.hpp"
+#include "sound.hpp"
+#include "spscring.hpp"
+#include "triplebuffer.hpp"
+
+// A CHIP-8 key change, stamped with when the frontend received it
+struct KeyEvent {
+    uint8_t key;
+    bool pressed;
+    std::chrono::steady_clock::time_point time;
+};
+
+// Runs a Chip8 on its own thread, paced in 60 Hz frames by a Scheduler, so a
+// slow present on the UI thread never delays emulation. Key events come in
+// through an SPSC queue and every finished frame goes out through a triple
+// buffer; neither side takes a lock or waits on the other. The Chip8 belongs
+// to the thread between start() and stop().
+class EmulationThread {
+    public:
+        static const std::size_t INPUT_QUEUE_SIZE = 256;
+        static const int ALIGN_STEPS = 8;       // Frames to close most of a phase error over
+
+        struct Frame {
+            Display display;
+            bool hires;
+            unsigned long long number;                      // Frames run before this one
+            std::chrono::steady_clock::time_point time;     // When the frame was published
+        };
+
+        EmulationThread(Chip8& chip8, unsigned int instructionsPerSecond);
+        ~EmulationThread();
+
+        // Appends every key event applied to the recording. Rewinding is
+        // ignored while recording, since it would branch the timeline.
+        void setRecording(InputRecording* recording);
+
+        // Opens and closes the channel's gate with the sound timer at the end
+        // of every frame, and hands it the XO-CHIP pattern once there is one
+        void setSoundChannel(SoundChannel* sound);
+
+        void start();
+        void stop();
+
+        // UI thread. False if the queue is full and the event was dropped.
+        bool pushKey(const KeyEvent& event);
+        void setRewinding(bool rewinding);
+
+        // UI thread: reports when the last present reached the display and the
+        // refresh period. Frame deadlines then drift toward the middle of each
+        // refresh, so one frame is ready for every present. A zero period
+        // stops aligning.
+        void alignFrames(std::chrono::steady_clock::time_point present, std::chrono::steady_clock::duration period);
+
+        // UI thread: moves to the newest published frame, false if there is none since the last call
+        bool updateFrame();
+        const Frame& getFrame() const;
+
+        bool hasTrapped() const;        // The thread stops itself on an invalid opcode
+
+        // Only meaningful once stopped
+        unsigned long long getCycleCount() const;
+        unsigned long long getInputCount() const;
+        std::chrono::steady_clock::duration getInputLatencyTotal() const;     // Key event to the publish of the frame that used it
+        std::chrono::steady_clock::duration getInputLatencyMax() const;
+
+    private:
+        Chip8& chip8;
+        Scheduler scheduler;
+        Rewind rewind;
+        InputRecording* recording;
+        SoundChannel* sound;
+        SpscRing<KeyEvent> input;
+        TripleBuffer<Frame> frames;
+        std::thread thread;
+        std::atomic<bool> running;
+        std::atomic<bool> rewinding;
+        std::atomic<bool> trapped;
+        std::atomic<long long> presentTime;     // steady_clock ticks
+        std::atomic<long long> presentPeriod;   // steady_clock ticks, 0 when not aligning
+        unsigned long long inputCount;
+        std::chrono::steady_clock::duration inputLatencyTotal;
+        std::chrono::steady_clock::duration inputLatencyMax;
+
+        void loop();
+        void alignToDisplay();
+};
@@ -0,0 +1,106 @@
+#include "framepacer.hpp"
+#include <cmath>
+#include <thread>
+
+const FramePacer::Clock::duration FramePacer::POLL_INTERVAL = std::chrono::microseconds(500);
+
+namespace {
+    const double FRAME_RATE = 60.0;
+
+    // Quarter-millisecond buckets up to 100 ms
+    const Histogram::Duration BUCKET_WIDTH = std::chrono::microseconds(250);
+    const std::size_t BUCKET_COUNT = 400;
+
+    double milliseconds(FramePacer::Clock::duration value) {
+        return std::chrono::duration<double, std::milli>(value).count();
+    }
+}
+
+FramePacer::FramePacer(Mode mode, double refreshRate, bool vsync)
+    : mode(mode), vsync(vsync), hasFrame(false), lastFrame(0), freshCount(0), droppedCount(0), repeatedCount(0),
+      frameTimes(BUCKET_WIDTH, BUCKET_COUNT), presentLatency(BUCKET_WIDTH, BUCKET_COUNT) {
+    if (refreshRate <= 0) {
+        refreshRate = FRAME_RATE;
+    }
+
+    refreshPeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / refreshRate));
+    nextRefresh = Clock::now() + refreshPeriod;
+}
+
+bool FramePacer::shouldPresent(bool freshFrame) const {
+    return mode == Mode::Smooth ? hasFrame : freshFrame;
+}
+
+void FramePacer::received(unsigned long long frameNumber) {
+    if (hasFrame && frameNumber > lastFrame + 1) {
+        droppedCount += frameNumber - lastFrame - 1;
+    }
+
+    hasFrame = true;
+    lastFrame = frameNumber;
+    freshCount++;
+}
+
+void FramePacer::presented(Clock::time_point publishTime, bool freshFrame) {
+    Clock::time_point now = Clock::now();
+
+    if (frameTimes.getCount() > 0 || presentLatency.getCount() > 0) {
+        frameTimes.add(now - lastPresent);
+    }
+
+    if (freshFrame) {
+        presentLatency.add(now - publishTime);
+    } else {
+        repeatedCount++;
+    }
+
+    lastPresent = now;
+}
+
+void FramePacer::wait() {
+    if (mode == Mode::Latency || !hasFrame) {
+        std::this_thread::sleep_for(POLL_INTERVAL);
+    } else if (!vsync) {
+        Clock::time_point now = Clock::now();
+
+        // Fell a whole refresh behind: restart the timer rather than presenting back to back
+        if (now > nextRefresh + refreshPeriod) {
+            nextRefresh = now;
+        }
+
+        std::this_thread::sleep_until(nextRefresh);
+        nextRefresh += refreshPeriod;
+    }
+
+    // With vsync, the present itself blocked until the refresh
+}
+
+bool FramePacer::alignsFrames() const {
+    double rate = 1.0 / std::chrono::duration<double>(refreshPeriod).count();
+    return mode == Mode::Smooth && std::fabs(rate - FRAME_RATE) <= FRAME_RATE * ALIGN_TOLERANCE;
+}
+
+FramePacer::Clock::time_point FramePacer::getLastPresent() const {
+    return lastPresent;
+}
+
+FramePacer::Clock::duration FramePacer::getRefreshPeriod() const {
+    return refreshPeriod;
+}
+
+unsigned long long FramePacer::getPresentCount() const {
+    return presentLatency.getCount() + repeatedCount;
+}
+
+void FramePacer::writeReport(std::ostream& out) const {
+    out << "Pacing:          " << (mode == Mode::Smooth ? "smooth" : "lowest latency")
+        << (mode == Mode::Smooth ? (vsync ? ", vsync" : ", timer") : "")
+        << ", " << 1000.0 / milliseconds(refreshPeriod) << " Hz display"
+        << (alignsFrames() ? ", frames aligned to it\n" : "\n");
+    out << "Frames:          " << getPresentCount() << " presented, " << freshCount << " new, "
+        << droppedCount << " dropped, " << repeatedCount << " repeated\n";
+    out << "Frame time:      ";
+    frameTimes.writeSummary(out);
+    out << "Present latency: ";
+    presentLatency.writeSummary(out);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include "histogram.hpp"
+
+// Decides when the UI thread presents, and records frame times and present
+// latency.
+//
+// Latency mode presents every new frame as soon as it is published, without
+// vsync, and may tear. Smooth mode presents once per display refresh. It
+// repeats the last frame when no new one is ready, and a new frame that
+// arrives before an older one was shown replaces it. It waits on vsync when
+// the renderer has it, and on a timer at the refresh rate otherwise, e.g.
+// under the dummy video driver.
+class FramePacer {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        enum class Mode {
+            Latency,
+            Smooth
+        };
+
+        static constexpr double ALIGN_TOLERANCE = 0.03;     // Displays this close to 60 Hz get emulated frames aligned to them
+        static const Clock::duration POLL_INTERVAL;         // Latency mode checks for a new frame this often
+
+        // refreshRate is in Hz, 0 when unknown
+        FramePacer(Mode mode, double refreshRate, bool vsync);
+
+        // Whether the UI loop should present this pass
+        bool shouldPresent(bool freshFrame) const;
+
+        // A new frame was taken from the emulation thread; gaps in the numbers are dropped frames
+        void received(unsigned long long frameNumber);
+
+        // A present of a frame published at publishTime just returned
+        void presented(Clock::time_point publishTime, bool freshFrame);
+
+        // Sleeps until the next pass of the UI loop is due
+        void wait();
+
+        // True when the emulation thread should align its frames to getLastPresent() and getRefreshPeriod()
+        bool alignsFrames() const;
+        Clock::time_point getLastPresent() const;
+        Clock::duration getRefreshPeriod() const;
+        unsigned long long getPresentCount() const;
+
+        void writeReport(std::ostream& out) const;
+
+    private:
+        Mode mode;
+        bool vsync;
+        Clock::duration refreshPeriod;
+        Clock::time_point nextRefresh;          // Timer deadline when there is no vsync
+        Clock::time_point lastPresent;
+        bool hasFrame;                          // A frame was received yet
+        unsigned long long lastFrame;
+        unsigned long long freshCount;
+        unsigned long long droppedCount;
+        unsigned long long repeatedCount;
+        Histogram frameTimes;                   // Between consecutive presents
+        Histogram presentLatency;               // From publish to present
+};
@@ -1,12 +1,33 @@
 #include "graphics.hpp"
+#include <cstring>
 #include <iostream>
 
-Graphics::Graphics(const char* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight) {
+Graphics::Graphics(const char* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight, bool vsync) {
+    Uint32 vsyncFlag = vsync ? SDL_RENDERER_PRESENTVSYNC : 0;
     SDL_Init(SDL_INIT_VIDEO);
 
     window = SDL_CreateWindow(title, 100, 100, windowWidth, windowHeight, SDL_WINDOW_SHOWN);
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | vsyncFlag);
+
+    // No GPU, e.g. under the dummy video driver
+    if (!renderer) {
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE | vsyncFlag);
+    }
+
+    SDL_RendererInfo info;
+    SDL_DisplayMode mode;
+    const char* driver = SDL_GetCurrentVideoDriver();
+
+    // The dummy driver accepts the flag, but has no display to wait for
+    this->vsync = vsync && SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC)
+        && !(driver && std::strcmp(driver, "dummy") == 0);
+
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) == 0) {
+        refreshRate = mode.refresh_rate;
+    }
+
     texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, textureWidth, textureHeight);
+    this->textureWidth = textureWidth;
 }
 
 Graphics::~Graphics() {
@@ -16,164 +37,81 @@ Graphics::~Graphics() {
     SDL_Quit();
 }
 
-void Graphics::updateScreen(const void* buffer, int pitch) {
-    SDL_UpdateTexture(texture, nullptr, buffer, pitch);
+void Graphics::updateScreen(const Display& display, bool hires, uint64_t dirtyRows) {
+    if (dirtyRows) {
+        SDL_Rect rect;
+        void* pixels;
+        int pitch;
+        int scale = hires ? 1 : 2;      // Texture rows per display row
+        int firstRow = 0;
+        int lastRow = Display::height(hires) - 1;
+
+        while (!(dirtyRows & (1ull << firstRow))) {
+            firstRow++;
+        }
+
+        while (!(dirtyRows & (1ull << lastRow))) {
+            lastRow--;
+        }
+
+        rect.x = 0;
+        rect.y = firstRow * scale;
+        rect.w = textureWidth;
+        rect.h = (lastRow - firstRow + 1) * scale;
+
+        // Locked pixels are write-only, so every row in the range is expanded, not just the dirty ones
+        if (SDL_LockTexture(texture, &rect, &pixels, &pitch) == 0) {
+            display.expand(hires, static_cast<uint32_t*>(pixels), pitch, rect.y, rect.h);
+            SDL_UnlockTexture(texture);
+        }
+    }
+
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, texture, nullptr, nullptr);
     SDL_RenderPresent(renderer);
 }
 
-bool Graphics::input(bool* keyPressedState) {
+bool Graphics::input(std::vector<KeyEvent>& events) {
     bool quit = false;
     SDL_Event e;
 
     while (SDL_PollEvent(&e)) {
-        switch (e.type) {
-            case SDL_QUIT:
-                quit = true;
-                break;
-            
-            case SDL_KEYDOWN:
-                switch (e.key.keysym.sym) {
-                    case SDLK_ESCAPE:
-                        quit = true;
-                        break;
-
-                    case SDLK_x:
-                        keyPressedState[0x0] = 1;
-                        break;
-
-                    case SDLK_1:
-                        keyPressedState[0x1] = 1;
-                        break;
-
-                    case SDLK_2:
-                        keyPressedState[0x2] = 1;
-                        break;
-
-                    case SDLK_3:
-                        keyPressedState[0x3] = 1;
-                        break;
-
-                    case SDLK_q:
-                        keyPressedState[0x4] = 1;
-                        break;
-
-                    case SDLK_w:
-                        keyPressedState[0x5] = 1;
-                        break;
-
-                    case SDLK_e:
-                        keyPressedState[0x6] = 1;
-                        break;
-
-                    case SDLK_a:
-                        keyPressedState[0x7] = 1;
-                        break;
-
-                    case SDLK_s:
-                        keyPressedState[0x8] = 1;
-                        break;
-
-                    case SDLK_d:
-                        keyPressedState[0x9] = 1;
-                        break;
-
-                    case SDLK_z:
-                        keyPressedState[0xA] = 1;
-                        break;
-
-                    case SDLK_c:
-                        keyPressedState[0xB] = 1;
-                        break;
-
-                    case SDLK_4:
-                        keyPressedState[0xC] = 1;
-                        break;
-
-                    case SDLK_r:
-                        keyPressedState[0xD] = 1;
-                        break;
-
-                    case SDLK_f:
-                        keyPressedState[0xE] = 1;
-                        break;
-
-                    case SDLK_v:
-                        keyPressedState[0xF] = 1;
-                        break;
+        if (e.type == SDL_QUIT) {
+            quit = true;
+        } else if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
+            bool pressed = e.type == SDL_KEYDOWN;
+
+            if (e.key.keysym.sym == SDLK_ESCAPE) {
+                quit = quit || pressed;
+            } else if (e.key.keysym.sym == SDLK_BACKSPACE) {
+                rewindHeld = pressed;
+            } else if (!e.key.repeat) {
+                int8_t key = keymap.lookup(e.key.keysym.scancode);
+
+                if (key != Keymap::UNMAPPED) {
+                    // SDL stamps events in milliseconds since it started
+                    auto age = std::chrono::milliseconds(SDL_GetTicks() - e.key.timestamp);
+                    events.push_back({ static_cast<uint8_t>(key), pressed, std::chrono::steady_clock::now() - age });
                 }
-                break;
-
-            case SDL_KEYUP:
-                switch(e.key.keysym.sym) {
-                    case SDLK_x:
-                        keyPressedState[0x0] = 0;
-                        break;
-
-                    case SDLK_1:
-                        keyPressedState[0x1] = 0;
-                        break;
-
-                    case SDLK_2:
-                        keyPressedState[0x2] = 0;
-                        break;
-
-                    case SDLK_3:
-                        keyPressedState[0x3] = 0;
-                        break;
-
-                    case SDLK_q:
-                        keyPressedState[0x4] = 0;
-                        break;
-
-                    case SDLK_w:
-                        keyPressedState[0x5] = 0;
-                        break;
-
-                    case SDLK_e:
-                        keyPressedState[0x6] = 0;
-                        break;
-
-                    case SDLK_a:
-                        keyPressedState[0x7] = 0;
-                        break;
-
-                    case SDLK_s:
-                        keyPressedState[0x8] = 0;
-                        break;
-
-                    case SDLK_d:
-                        keyPressedState[0x9] = 0;
-                        break;
-
-                    case SDLK_z:
-                        keyPressedState[0xA] = 0;
-                        break;
-
-                    case SDLK_c:
-                        keyPressedState[0xB] = 0;
-                        break;
+            }
+        }
+    }
 
-                    case SDLK_4:
-                        keyPressedState[0xC] = 0;
-                        break;
+    return quit;
+}
 
-                    case SDLK_r:
-                        keyPressedState[0xD] = 0;
-                        break;
+void Graphics::setKeymap(const Keymap& keymap) {
+    this->keymap = keymap;
+}
 
-                    case SDLK_f:
-                        keyPressedState[0xE] = 0;
-                        break;
+bool Graphics::isRewinding() const {
+    return rewindHeld;
+}
 
-                    case SDLK_v:
-                        keyPressedState[0xF] = 0;
-                        break;
-                }
-                break;
-        }
-    }
+bool Graphics::hasVsync() const {
+    return vsync;
+}
 
-    return quit;
+double Graphics::getRefreshRate() const {
+    return refreshRate;
 }
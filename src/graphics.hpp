@@ -1,21 +1,45 @@
+#pragma once
+
 #include <SDL.h>
+#include <cstdint>
+#include <vector>
+#include "chip8.hpp"
+#include "emulation.hpp"
+#include "keymap.hpp"
 
 class Graphics {
     private:
         SDL_Window* window{};       // The window to render to
         SDL_Renderer* renderer{};   // The object that will be rendering
         SDL_Texture* texture{};     // The texture to draw to the window
+        int textureWidth{};
+        bool rewindHeld{};          // Backspace is down
+        bool vsync{};               // Presents block until the display refreshes
+        double refreshRate{};       // Of the window's display in Hz, 0 if unknown
+        Keymap keymap;
 
     public:
-        // Constructor
-        Graphics(const char* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight);
+        // Constructor. vsync asks for presents that wait for the display to refresh.
+        Graphics(const char* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight, bool vsync = false);
 
         // Destructor
         ~Graphics();
 
-        // Updates window at every game tick
-        void updateScreen(const void* buffer, int pitch);
+        // Expands the rows of display set in dirtyRows (bit N for row N of
+        // the current resolution) straight into the locked 128x64 texture and
+        // presents the window. With no rows set, presents the texture as it is.
+        void updateScreen(const Display& display, bool hires, uint64_t dirtyRows);
+
+        // Appends the CHIP-8 key changes since the last call to events, in
+        // the order they happened. Returns true when the user quits.
+        bool input(std::vector<KeyEvent>& events);
+
+        void setKeymap(const Keymap& keymap);
+
+        // True while the rewind key is held
+        bool isRewinding() const;
 
-        // Handles keyboard input
-        bool input(bool* keyPressedState);
+        // Whether presents really wait for vsync; never under the dummy video driver
+        bool hasVsync() const;
+        double getRefreshRate() const;
 };
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "histogram.hpp"
+#include <algorithm>
+#include <iomanip>
+
+Histogram::Histogram(Duration bucketWidth, std::size_t bucketCount)
+    : bucketWidth(bucketWidth), buckets(bucketCount + 1, 0), count(0), total(), max() {
+}
+
+void Histogram::add(Duration value) {
+    value = std::max(value, Duration::zero());
+    std::size_t bucket = std::min<std::size_t>(value / bucketWidth, buckets.size() - 1);
+
+    buckets[bucket]++;
+    count++;
+    total += value;
+    max = std::max(max, value);
+}
+
+void Histogram::clear() {
+    std::fill(buckets.begin(), buckets.end(), 0);
+    count = 0;
+    total = Duration::zero();
+    max = Duration::zero();
+}
+
+unsigned long long Histogram::getCount() const {
+    return count;
+}
+
+Histogram::Duration Histogram::getMean() const {
+    return count ? total / static_cast<Duration::rep>(count) : Duration::zero();
+}
+
+Histogram::Duration Histogram::getMax() const {
+    return max;
+}
+
+Histogram::Duration Histogram::getPercentile(double percent) const {
+    unsigned long long rank = static_cast<unsigned long long>(count * percent / 100.0);
+    unsigned long long seen = 0;
+
+    for (std::size_t bucket = 0; bucket + 1 < buckets.size(); ++bucket) {
+        seen += buckets[bucket];
+
+        if (seen > rank) {
+            return std::min(bucketWidth * static_cast<Duration::rep>(bucket + 1), max);
+        }
+    }
+
+    return max;
+}
+
+void Histogram::writeSummary(std::ostream& out) const {
+    auto ms = [](Duration value) {
+        return std::chrono::duration<double, std::milli>(value).count();
+    };
+
+    std::ios format(nullptr);
+    format.copyfmt(out);
+
+    out << count << " samples, " << std::fixed << std::setprecision(2)
+        << "mean " << ms(getMean()) << " ms, p50 " << ms(getPercentile(50)) << " ms, p95 " << ms(getPercentile(95))
+        << " ms, p99 " << ms(getPercentile(99)) << " ms, max " << ms(max) << " ms\n";
+    out.copyfmt(format);
+}
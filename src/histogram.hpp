@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// Counts durations in fixed-width buckets from zero, plus one bucket for
+// everything past the last. Percentiles are bucket upper bounds, so they are
+// accurate to one bucket width.
+class Histogram {
+    public:
+        typedef std::chrono::steady_clock::duration Duration;
+
+        Histogram(Duration bucketWidth, std::size_t bucketCount);
+
+        void add(Duration value);
+        void clear();
+
+        unsigned long long getCount() const;
+        Duration getMean() const;
+        Duration getMax() const;
+        Duration getPercentile(double percent) const;
+
+        // One line of count, mean, 50th/95th/99th percentile and maximum, in milliseconds
+        void writeSummary(std::ostream& out) const;
+
+    private:
+        Duration bucketWidth;
+        std::vector<unsigned long long> buckets;    // The last one counts overflows
+        unsigned long long count;
+        Duration total;
+        Duration max;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+// An opcode with its operands already extracted
+struct Instruction {
+    uint8_t op;                 // Index into the handler table
+    uint8_t x;
+    uint8_t y;
+    uint8_t n;
+    uint8_t nn;
+    uint16_t nnn;
+};
@@ -0,0 +1,356 @@
+#include "jit.hpp"
+#include "chip8.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define CHIP8_JIT_X64 1
+    #if defined(_WIN32)
+        #include <windows.h>
+    #else
+        #include <sys/mman.h>
+    #endif
+#else
+    #define CHIP8_JIT_X64 0
+#endif
+
+namespace {
+    // x86 register numbers
+    const int EAX = 0;
+    const int ECX = 1;
+    const int EDX = 2;
+
+    // Extension fields of the group opcodes 0x80 and 0xD0
+    const int EXT_ADD = 0;
+    const int EXT_SHL = 4;
+    const int EXT_SHR = 5;
+    const int EXT_CMP = 7;
+
+    const uint8_t CMOVE = 0x44;
+    const uint8_t CMOVNE = 0x45;
+}
+
+bool Jit::isSupported() {
+    return CHIP8_JIT_X64;
+}
+
+Jit::Jit(Chip8& chip8) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(&chip8);
+
+    registersOffset = reinterpret_cast<const uint8_t*>(&chip8.registers[0]) - base;
+    indexOffset = reinterpret_cast<const uint8_t*>(&chip8.indexReg) - base;
+    pcOffset = reinterpret_cast<const uint8_t*>(&chip8.pc) - base;
+    delayTimerOffset = reinterpret_cast<const uint8_t*>(&chip8.delayTimer) - base;
+    soundTimerOffset = reinterpret_cast<const uint8_t*>(&chip8.soundTimer) - base;
+
+    code = nullptr;
+    used = 0;
+    full = false;
+    compiledCount = 0;
+    out = nullptr;
+
+#if CHIP8_JIT_X64
+    #if defined(_WIN32)
+        code = static_cast<uint8_t*>(VirtualAlloc(nullptr, CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READ));
+    #else
+        void* mapping = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        code = mapping == MAP_FAILED ? nullptr : static_cast<uint8_t*>(mapping);
+    #endif
+#endif
+}
+
+Jit::~Jit() {
+    if (!code) {
+        return;
+    }
+
+#if CHIP8_JIT_X64
+    #if defined(_WIN32)
+        VirtualFree(code, 0, MEM_RELEASE);
+    #else
+        munmap(code, CODE_SIZE);
+    #endif
+#endif
+}
+
+bool Jit::isFull() const {
+    return full;
+}
+
+void Jit::reset() {
+    used = 0;
+    full = false;
+}
+
+unsigned long long Jit::getCompiledCount() const {
+    return compiledCount;
+}
+
+void Jit::setWritable(bool writable) {
+#if CHIP8_JIT_X64
+    #if defined(_WIN32)
+        DWORD old;
+        VirtualProtect(code, CODE_SIZE, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &old);
+    #else
+        mprotect(code, CODE_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC);
+    #endif
+#endif
+}
+
+// Calls and returns are left to the interpreter, whose handlers trap when
+// the stack would overflow or underflow
+bool Jit::canCompile(uint8_t op) {
+    switch (op) {
+        case Chip8::OP_1NNN: case Chip8::OP_3XNN: case Chip8::OP_4XNN: case Chip8::OP_5XY0:
+        case Chip8::OP_6XNN: case Chip8::OP_7XNN: case Chip8::OP_8XY0: case Chip8::OP_8XY1:
+        case Chip8::OP_8XY2: case Chip8::OP_8XY3: case Chip8::OP_8XY4: case Chip8::OP_8XY5:
+        case Chip8::OP_8XY6: case Chip8::OP_8XY7: case Chip8::OP_8XYE: case Chip8::OP_9XY0:
+        case Chip8::OP_ANNN: case Chip8::OP_FX07: case Chip8::OP_FX15: case Chip8::OP_FX18:
+        case Chip8::OP_FX1E: case Chip8::OP_FX29:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Jit::compile(Block& block) {
+    if (!code || full) {
+        return false;
+    }
+
+    unsigned int length = 0;
+
+    while (length < block.instrs.size() && canCompile(block.instrs[length].op)) {
+        length++;
+    }
+
+    if (length == 0) {
+        return false;
+    }
+
+    // Worst case is well under 64 bytes per instruction
+    if (used + 64 * (length + 1) > CODE_SIZE) {
+        full = true;
+        return false;
+    }
+
+    setWritable(true);
+
+    uint8_t* entry = code + used;
+    out = entry;
+
+    emit8(0x53);                                    // push rbx
+#if defined(_WIN32)
+    emit8(0x48); emit8(0x89); emit8(0xCB);          // mov rbx, rcx
+#else
+    emit8(0x48); emit8(0x89); emit8(0xFB);          // mov rbx, rdi
+#endif
+
+    for (unsigned int i = 0; i < length; ++i) {
+        emitInstruction(block.instrs[i], block.start + 2 * (i + 1));
+    }
+
+    // Control flow instructions set pc themselves; otherwise continue after the compiled run
+    if (!Chip8::endsBlock(block.instrs[length - 1].op)) {
+        emitStoreImm16(pcOffset, block.start + 2 * length);
+    }
+
+    emit8(0x5B);                                    // pop rbx
+    emit8(0xC3);                                    // ret
+
+    used = out - code;
+    setWritable(false);
+
+    block.native = reinterpret_cast<void (*)(Chip8*)>(entry);
+    block.nativeLength = length;
+    compiledCount++;
+    return true;
+}
+
+// Mirrors the interpreter handlers operation for operation, including which
+// register values are re-read after VF is written, so results match when X or Y is F.
+void Jit::emitInstruction(const Instruction& instr, uint16_t next) {
+    int32_t vx = reg(instr.x);
+    int32_t vy = reg(instr.y);
+    int32_t vf = reg(0xF);
+
+    switch (instr.op) {
+        case Chip8::OP_1NNN:
+            emitStoreImm16(pcOffset, instr.nnn);
+            break;
+
+        case Chip8::OP_3XNN:
+            emit8(0x80); emitMem(EXT_CMP, vx); emit8(instr.nn);                 // cmp byte [Vx], nn
+            emitSkip(CMOVE, next);
+            break;
+
+        case Chip8::OP_4XNN:
+            emit8(0x80); emitMem(EXT_CMP, vx); emit8(instr.nn);
+            emitSkip(CMOVNE, next);
+            break;
+
+        case Chip8::OP_5XY0:
+            emitLoad8(EDX, vx);
+            emit8(0x3A); emitMem(EDX, vy);                                      // cmp dl, [Vy]
+            emitSkip(CMOVE, next);
+            break;
+
+        case Chip8::OP_9XY0:
+            emitLoad8(EDX, vx);
+            emit8(0x3A); emitMem(EDX, vy);
+            emitSkip(CMOVNE, next);
+            break;
+
+        case Chip8::OP_6XNN:
+            emitStoreImm8(vx, instr.nn);
+            break;
+
+        case Chip8::OP_7XNN:
+            emit8(0x80); emitMem(EXT_ADD, vx); emit8(instr.nn);                 // add byte [Vx], nn
+            break;
+
+        case Chip8::OP_8XY0:
+            emitLoad8(EAX, vy);
+            emitStore8(EAX, vx);
+            break;
+
+        case Chip8::OP_8XY1:
+            emitLoad8(EAX, vy);
+            emit8(0x08); emitMem(EAX, vx);                                      // or [Vx], al
+            break;
+
+        case Chip8::OP_8XY2:
+            emitLoad8(EAX, vy);
+            emit8(0x20); emitMem(EAX, vx);                                      // and [Vx], al
+            break;
+
+        case Chip8::OP_8XY3:
+            emitLoad8(EAX, vy);
+            emit8(0x30); emitMem(EAX, vx);                                      // xor [Vx], al
+            break;
+
+        case Chip8::OP_8XY4:
+            emitLoad8(EAX, vx);
+            emitLoad8(ECX, vy);
+            emit8(0x01); emit8(0xC8);                                           // add eax, ecx
+            emit8(0x3D); emit32(255);                                           // cmp eax, 255
+            emit8(0x0F); emit8(0x97); emit8(0xC2);                              // seta dl
+            emitStore8(EDX, vf);
+            emitLoad8(EAX, vy);
+            emit8(0x00); emitMem(EAX, vx);                                      // add [Vx], al
+            break;
+
+        case Chip8::OP_8XY5:
+            emitLoad8(EAX, vx);
+            emitLoad8(ECX, vy);
+            emit8(0x39); emit8(0xC8);                                           // cmp eax, ecx
+            emit8(0x0F); emit8(0x97); emit8(0xC2);                              // seta dl
+            emitStore8(EDX, vf);
+            emitLoad8(EAX, vy);
+            emit8(0x28); emitMem(EAX, vx);                                      // sub [Vx], al
+            break;
+
+        case Chip8::OP_8XY6:
+            emitLoad8(EAX, vx);
+            emit8(0x83); emit8(0xE0); emit8(0x01);                              // and eax, 1
+            emitStore8(EAX, vf);
+            emit8(0xD0); emitMem(EXT_SHR, vx);                                  // shr byte [Vx], 1
+            break;
+
+        case Chip8::OP_8XY7:
+            emitLoad8(EAX, vy);
+            emitLoad8(ECX, vx);
+            emit8(0x39); emit8(0xC8);                                           // cmp eax, ecx
+            emit8(0x0F); emit8(0x97); emit8(0xC2);                              // seta dl
+            emitStore8(EDX, vf);
+            emitLoad8(EAX, vy);
+            emit8(0x2A); emitMem(EAX, vx);                                      // sub al, [Vx]
+            emitStore8(EAX, vx);
+            break;
+
+        case Chip8::OP_8XYE:
+            emitLoad8(EAX, vx);
+            emit8(0xC1); emit8(0xE8); emit8(0x07);                              // shr eax, 7
+            emitStore8(EAX, vf);
+            emit8(0xD0); emitMem(EXT_SHL, vx);                                  // shl byte [Vx], 1
+            break;
+
+        case Chip8::OP_ANNN:
+            emitStoreImm16(indexOffset, instr.nnn);
+            break;
+
+        case Chip8::OP_FX07:
+            emitLoad8(EAX, delayTimerOffset);
+            emitStore8(EAX, vx);
+            break;
+
+        case Chip8::OP_FX15:
+            emitLoad8(EAX, vx);
+            emitStore8(EAX, delayTimerOffset);
+            break;
+
+        case Chip8::OP_FX18:
+            emitLoad8(EAX, vx);
+            emitStore8(EAX, soundTimerOffset);
+            break;
+
+        case Chip8::OP_FX1E:
+            emitLoad8(EAX, vx);
+            emit8(0x66); emit8(0x01); emitMem(EAX, indexOffset);                // add [I], ax
+            break;
+
+        case Chip8::OP_FX29:
+            emitLoad8(EAX, vx);
+            emit8(0x8D); emit8(0x44); emit8(0x80); emit8(0x50);                 // lea eax, [rax + rax*4 + 0x50]
+            emitStore16(EAX, indexOffset);
+            break;
+    }
+}
+
+void Jit::emitSkip(uint8_t cmovOpcode, uint16_t next) {
+    emit8(0xB8); emit32(next);                                                  // mov eax, next
+    emit8(0xB9); emit32(next + 2);                                              // mov ecx, next + 2
+    emit8(0x0F); emit8(cmovOpcode); emit8(0xC1);                                // cmovcc eax, ecx
+    emitStore16(EAX, pcOffset);
+}
+
+void Jit::emit8(uint8_t byte) {
+    *out++ = byte;
+}
+
+void Jit::emit16(uint16_t word) {
+    emit8(word & 0xFF);
+    emit8(word >> 8);
+}
+
+void Jit::emit32(uint32_t dword) {
+    emit16(dword & 0xFFFF);
+    emit16(dword >> 16);
+}
+
+void Jit::emitMem(int reg, int32_t disp) {
+    emit8(0x83 | (reg << 3));       // mod = 10, rm = rbx
+    emit32(disp);
+}
+
+void Jit::emitLoad8(int reg, int32_t disp) {
+    emit8(0x0F); emit8(0xB6); emitMem(reg, disp);
+}
+
+void Jit::emitStore8(int reg, int32_t disp) {
+    emit8(0x88); emitMem(reg, disp);
+}
+
+void Jit::emitStore16(int reg, int32_t disp) {
+    emit8(0x66); emit8(0x89); emitMem(reg, disp);
+}
+
+void Jit::emitStoreImm8(int32_t disp, uint8_t imm) {
+    emit8(0xC6); emitMem(0, disp); emit8(imm);
+}
+
+void Jit::emitStoreImm16(int32_t disp, uint16_t imm) {
+    emit8(0x66); emit8(0xC7); emitMem(0, disp); emit16(imm);
+}
+
+int32_t Jit::reg(uint8_t x) const {
+    return registersOffset + x;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "blockcache.hpp"
+
+class Chip8;
+
+// Translates cached blocks into x86-64 code. Compiled code gets the Chip8 it
+// runs on in rbx and reads and writes the guest registers, I, pc, sp and the
+// stack in place, so the interpreter can pick up exactly where it leaves off.
+// Only the leading run of instructions with a native translation is compiled;
+// draws, key ops, random numbers and memory accesses are left to the interpreter.
+class Jit {
+    public:
+        static const unsigned int HOT_THRESHOLD = 16;          // Block runs before compiling
+        static const std::size_t CODE_SIZE = 1024 * 1024;      // Bytes of executable memory
+
+        // Whether this build can generate and run native code
+        static bool isSupported();
+
+        explicit Jit(Chip8& chip8);
+        ~Jit();
+
+        // Sets block->native and block->nativeLength; returns false when nothing
+        // in the block could be compiled or the code buffer is full
+        bool compile(Block& block);
+
+        // The code buffer is full; every block pointing into it must be dropped before reset()
+        bool isFull() const;
+        void reset();
+
+        unsigned long long getCompiledCount() const;
+
+    private:
+        uint8_t* code;
+        std::size_t used;
+        bool full;
+        unsigned long long compiledCount;
+
+        // Offsets of guest state from the start of the Chip8 object
+        int32_t registersOffset;
+        int32_t indexOffset;
+        int32_t pcOffset;
+        int32_t delayTimerOffset;
+        int32_t soundTimerOffset;
+
+        uint8_t* out;               // Write position while compiling
+
+        static bool canCompile(uint8_t op);
+        void emitInstruction(const Instruction& instr, uint16_t next);
+        void setWritable(bool writable);
+
+        void emit8(uint8_t byte);
+        void emit16(uint16_t word);
+        void emit32(uint32_t dword);
+        void emitMem(int reg, int32_t disp);                   // ModRM for [rbx + disp32]
+        void emitLoad8(int reg, int32_t disp);                 // movzx reg, byte [rbx + disp]
+        void emitStore8(int reg, int32_t disp);                // mov byte [rbx + disp], reg8
+        void emitStore16(int reg, int32_t disp);               // mov word [rbx + disp], reg16
+        void emitStoreImm8(int32_t disp, uint8_t imm);
+        void emitStoreImm16(int32_t disp, uint16_t imm);
+        void emitSkip(uint8_t cmovOpcode, uint16_t next);      // pc = condition ? next + 2 : next
+
+        int32_t reg(uint8_t x) const;
+};
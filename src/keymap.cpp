@@ -0,0 +1,55 @@
+#include "keymap.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+Keymap::Keymap() {
+    const SDL_Scancode layout[16] = {
+        SDL_SCANCODE_X, SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3,
+        SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_A,
+        SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_Z, SDL_SCANCODE_C,
+        SDL_SCANCODE_4, SDL_SCANCODE_R, SDL_SCANCODE_F, SDL_SCANCODE_V
+    };
+
+    std::fill(table, table + SDL_NUM_SCANCODES, UNMAPPED);
+
+    for (int8_t key = 0; key < 16; ++key) {
+        table[layout[key]] = key;
+    }
+}
+
+bool Keymap::load(const char* filename) {
+    std::ifstream file(filename);
+    std::string line;
+    int8_t loaded[SDL_NUM_SCANCODES];
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::fill(loaded, loaded + SDL_NUM_SCANCODES, UNMAPPED);
+
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        unsigned int key;
+        std::string name;
+
+        if (line.empty() || line[0] == '#' || !(fields >> std::hex >> key)) {
+            continue;
+        }
+
+        // Key names may contain spaces, like "Left Shift"
+        std::getline(fields >> std::ws, name);
+        SDL_Scancode scancode = SDL_GetScancodeFromName(name.c_str());
+
+        if (scancode == SDL_SCANCODE_UNKNOWN || key > 0xF) {
+            return false;
+        }
+
+        loaded[scancode] = key;
+    }
+
+    std::copy(loaded, loaded + SDL_NUM_SCANCODES, table);
+    return true;
+}
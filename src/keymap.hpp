@@ -0,0 +1,28 @@
+#pragma once
+
+#include <SDL.h>
+#include <cstdint>
+
+// Maps physical keys to the 16 CHIP-8 keys through a table indexed by SDL
+// scancode, so a layout follows key positions rather than key labels.
+class Keymap {
+    public:
+        static const int8_t UNMAPPED = -1;
+
+        // 1234/QWER/ASDF/ZXCV over the 123C/456D/789E/A0BF keypad
+        Keymap();
+
+        // Replaces the table with the lines of a config file, each
+        // "<CHIP-8 key 0-F> <SDL key name>", e.g. "C 4" or "0 Space". Blank
+        // lines and # comments are skipped. Keeps the current table and
+        // returns false if the file can't be read or names an unknown key.
+        bool load(const char* filename);
+
+        // The CHIP-8 key for a scancode, or UNMAPPED
+        int8_t lookup(SDL_Scancode scancode) const {
+            return scancode >= 0 && scancode < SDL_NUM_SCANCODES ? table[scancode] : UNMAPPED;
+        }
+
+    private:
+        int8_t table[SDL_NUM_SCANCODES];
+};
@@ -0,0 +1,443 @@
+#include "lockstep.hpp"
+#include "chip8.hpp"
+
+#if CHIP8_LOCKSTEP_X64
+namespace lockstep_avx2 {
+    bool execute(LaneArrays& lanes, const Instruction& instr, const uint8_t* mask);
+}
+
+namespace lockstep_sse2 {
+    bool execute(LaneArrays& lanes, const Instruction& instr, const uint8_t* mask);
+}
+#endif
+
+namespace {
+    bool noKernel(LaneArrays&, const Instruction&, const uint8_t*) {
+        return false;
+    }
+}
+
+LockstepEngine::LockstepEngine(std::size_t laneCount) : laneCount(laneCount) {
+    std::size_t count = (laneCount + VECTOR_WIDTH - 1) / VECTOR_WIDTH * VECTOR_WIDTH;
+
+    lanes.count = count;
+
+    for (std::vector<uint8_t>& reg : lanes.registers) {
+        reg.assign(count, 0);
+    }
+
+    lanes.indexReg.assign(count, 0);
+    lanes.pc.assign(count, 0x200);
+    lanes.sp.assign(count, 0);
+    lanes.delayTimer.assign(count, 0);
+    lanes.soundTimer.assign(count, 0);
+    lanes.trapped.assign(count, 0);
+    lanes.stack.assign(count * LaneArrays::STACK_SIZE, 0);
+    lanes.memory.assign(count * LaneArrays::MEMORY_SIZE, 0);
+    lanes.display.resize(count);
+    lanes.hires.assign(count, 0);
+    lanes.rplFlags.assign(count * LaneArrays::RPL_FLAGS, 0);
+    lanes.keys.assign(count, 0);
+    lanes.keyWait.assign(count, Chip8::NO_KEY_WAIT);
+    Xorshift rng;
+    rng.seed(0);
+    lanes.rng.assign(count, rng);
+    lanes.scratch.assign(count, 0);
+    pending.assign(count, 0);
+    mask.assign(count, 0);
+
+    // Padding lanes are parked as trapped so they never run
+    std::fill(lanes.trapped.begin() + laneCount, lanes.trapped.end(), 1);
+
+    std::fill(image, image + LaneArrays::MEMORY_SIZE, 0);
+    std::copy(Chip8::fontset.begin(), Chip8::fontset.end(), image);
+    std::copy(Chip8::bigFontset.begin(), Chip8::bigFontset.end(), image + 0xA0);
+    std::fill(written, written + LaneArrays::MEMORY_SIZE, false);
+
+    for (std::size_t lane = 0; lane < count; ++lane) {
+        std::copy(image, image + LaneArrays::MEMORY_SIZE, &lanes.memory[lane * LaneArrays::MEMORY_SIZE]);
+        lanes.display[lane].clear();
+    }
+
+    kernel = noKernel;
+    kernelName = "scalar";
+
+#if CHIP8_LOCKSTEP_X64
+    kernel = lockstep_sse2::execute;
+    kernelName = "sse2";
+
+#if defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = lockstep_avx2::execute;
+        kernelName = "avx2";
+    }
+#endif
+#endif
+}
+
+bool LockstepEngine::loadROM(char const* filename) {
+    std::shared_ptr<const RomImage> rom = RomImage::open(filename, LaneArrays::MEMORY_SIZE);
+
+    return rom && loadROM(*rom);
+}
+
+bool LockstepEngine::loadROM(const RomImage& rom) {
+    if (rom.size() > RomImage::maxSize(LaneArrays::MEMORY_SIZE)) {
+        return false;
+    }
+
+    std::copy(rom.data(), rom.data() + rom.size(), image + RomImage::LOAD_ADDRESS);
+    std::fill(written, written + LaneArrays::MEMORY_SIZE, false);
+
+    for (std::size_t lane = 0; lane < lanes.count; ++lane) {
+        std::copy(image, image + LaneArrays::MEMORY_SIZE, &lanes.memory[lane * LaneArrays::MEMORY_SIZE]);
+    }
+
+    return true;
+}
+
+uint16_t LockstepEngine::fetch(std::size_t lane) const {
+    const uint8_t* memory = &lanes.memory[lane * LaneArrays::MEMORY_SIZE];
+    unsigned int pc = lanes.pc[lane];
+
+    return (memory[pc & 0xFFF] << 8) | memory[(pc + 1) & 0xFFF];
+}
+
+void LockstepEngine::writeMemory(std::size_t lane, unsigned int address, uint8_t value) {
+    address &= 0xFFF;
+    lanes.memory[lane * LaneArrays::MEMORY_SIZE + address] = value;
+    written[address] = true;
+}
+
+void LockstepEngine::step() {
+    std::size_t count = lanes.count;
+    uint8_t* pendingLanes = pending.data();
+    uint8_t* maskLanes = mask.data();
+    uint16_t* pc = lanes.pc.data();
+    const Instruction* table = Chip8::decodeTable();
+
+    for (std::size_t i = 0; i < count; ++i) {
+        pendingLanes[i] = lanes.trapped[i] ? 0 : 0xFF;
+    }
+
+    // Each pass runs every pending lane sharing the pc of the first one, so
+    // converged lanes take one pass and every lane advances exactly once
+    for (std::size_t first = 0; first < count; ++first) {
+        if (!pendingLanes[first]) {
+            continue;
+        }
+
+        uint16_t groupPc = pc[first];
+
+        // Rebuilt across every lane, since the kernels read all of it
+        for (std::size_t i = 0; i < count; ++i) {
+            maskLanes[i] = pendingLanes[i] & -static_cast<uint8_t>(pc[i] == groupPc);
+            pendingLanes[i] &= ~maskLanes[i];
+        }
+
+        // Code a lane has stored to can differ between lanes, so it is fetched and run per lane
+        if (written[groupPc & 0xFFF] || written[(groupPc + 1) & 0xFFF]) {
+            for (std::size_t lane = first; lane < count; ++lane) {
+                if (maskLanes[lane]) {
+                    const Instruction& instr = table[fetch(lane)];
+                    pc[lane] += 2;
+                    executeLane(lane, instr);
+                }
+            }
+            continue;
+        }
+
+        const Instruction& instr = table[(image[groupPc & 0xFFF] << 8) | image[(groupPc + 1) & 0xFFF]];
+
+        for (std::size_t i = 0; i < count; ++i) {
+            pc[i] += maskLanes[i] & 2;
+        }
+
+        if (!kernel(lanes, instr, maskLanes) && !executeMasked(instr)) {
+            for (std::size_t lane = first; lane < count; ++lane) {
+                if (maskLanes[lane]) {
+                    executeLane(lane, instr);
+                }
+            }
+        }
+    }
+}
+
+void LockstepEngine::run(unsigned long long cycles) {
+    for (unsigned long long i = 0; i < cycles; ++i) {
+        step();
+    }
+}
+
+void LockstepEngine::tickTimers() {
+    for (std::size_t i = 0; i < lanes.count; ++i) {
+        lanes.delayTimer[i] -= lanes.delayTimer[i] > 0;
+        lanes.soundTimer[i] -= lanes.soundTimer[i] > 0;
+    }
+}
+
+// Instructions on the 16-bit pc, index, stack and timers, written as plain
+// loops over all lanes; the compiler vectorizes the ones without a gather
+bool LockstepEngine::executeMasked(const Instruction& instr) {
+    const std::size_t count = lanes.count;
+    const uint8_t* maskLanes = mask.data();
+    const uint8_t* vx = lanes.registers[instr.x].data();
+    uint16_t* pc = lanes.pc.data();
+    uint16_t* indexReg = lanes.indexReg.data();
+
+    switch (instr.op) {
+        case Chip8::OP_0NNN:
+        case Chip8::OP_00DN:
+        case Chip8::OP_1NNN:
+            for (std::size_t i = 0; i < count; ++i) {
+                pc[i] = maskLanes[i] ? instr.nnn : pc[i];
+            }
+            return true;
+        case Chip8::OP_2NNN:
+            for (std::size_t i = 0; i < count; ++i) {
+                if (maskLanes[i] && lanes.sp[i] == LaneArrays::STACK_SIZE) {
+                    trap(i);
+                } else if (maskLanes[i]) {
+                    lanes.stack[i * LaneArrays::STACK_SIZE + lanes.sp[i]] = pc[i];
+                    lanes.sp[i]++;
+                    pc[i] = instr.nnn;
+                }
+            }
+            return true;
+        case Chip8::OP_00EE:
+            for (std::size_t i = 0; i < count; ++i) {
+                if (maskLanes[i] && lanes.sp[i] == 0) {
+                    trap(i);
+                } else if (maskLanes[i]) {
+                    lanes.sp[i]--;
+                    pc[i] = lanes.stack[i * LaneArrays::STACK_SIZE + lanes.sp[i]];
+                }
+            }
+            return true;
+        case Chip8::OP_ANNN:
+            for (std::size_t i = 0; i < count; ++i) {
+                indexReg[i] = maskLanes[i] ? instr.nnn : indexReg[i];
+            }
+            return true;
+        case Chip8::OP_FX1E:
+            for (std::size_t i = 0; i < count; ++i) {
+                indexReg[i] += maskLanes[i] & vx[i];
+            }
+            return true;
+        case Chip8::OP_FX29:
+            for (std::size_t i = 0; i < count; ++i) {
+                indexReg[i] = maskLanes[i] ? 0x50 + 5 * vx[i] : indexReg[i];
+            }
+            return true;
+        case Chip8::OP_FX07: {
+            uint8_t* x = lanes.registers[instr.x].data();
+
+            for (std::size_t i = 0; i < count; ++i) {
+                x[i] = maskLanes[i] ? lanes.delayTimer[i] : x[i];
+            }
+            return true;
+        }
+        case Chip8::OP_FX15:
+            for (std::size_t i = 0; i < count; ++i) {
+                lanes.delayTimer[i] = maskLanes[i] ? vx[i] : lanes.delayTimer[i];
+            }
+            return true;
+        case Chip8::OP_FX18:
+            for (std::size_t i = 0; i < count; ++i) {
+                lanes.soundTimer[i] = maskLanes[i] ? vx[i] : lanes.soundTimer[i];
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Scalar path, one lane at a time, matching the op_XXXX handlers of Chip8
+void LockstepEngine::executeLane(std::size_t lane, const Instruction& instr) {
+    uint8_t& vx = lanes.registers[instr.x][lane];
+    uint8_t& vy = lanes.registers[instr.y][lane];
+    uint8_t& vf = lanes.registers[0xF][lane];
+    uint16_t& pc = lanes.pc[lane];
+    uint16_t& indexReg = lanes.indexReg[lane];
+    uint8_t& sp = lanes.sp[lane];
+    uint16_t* stack = &lanes.stack[lane * LaneArrays::STACK_SIZE];
+    uint8_t* memory = &lanes.memory[lane * LaneArrays::MEMORY_SIZE];
+    Display& display = lanes.display[lane];
+    bool hires = lanes.hires[lane];
+    uint8_t* rplFlags = &lanes.rplFlags[lane * LaneArrays::RPL_FLAGS];
+    uint16_t keys = lanes.keys[lane];
+
+    switch (instr.op) {
+        case Chip8::OP_0NNN: case Chip8::OP_00DN: pc = instr.nnn; break;
+        case Chip8::OP_00E0: display.clear(); break;
+        case Chip8::OP_00EE:
+            if (sp == 0) {
+                trap(lane);
+            } else {
+                sp--;
+                pc = stack[sp];
+            }
+            break;
+        case Chip8::OP_1NNN: pc = instr.nnn; break;
+        case Chip8::OP_2NNN:
+            if (sp == LaneArrays::STACK_SIZE) {
+                trap(lane);
+            } else {
+                stack[sp] = pc;
+                sp++;
+                pc = instr.nnn;
+            }
+            break;
+        case Chip8::OP_3XNN: pc += vx == instr.nn ? 2 : 0; break;
+        case Chip8::OP_4XNN: pc += vx != instr.nn ? 2 : 0; break;
+        case Chip8::OP_5XY0: pc += vx == vy ? 2 : 0; break;
+        case Chip8::OP_6XNN: vx = instr.nn; break;
+        case Chip8::OP_7XNN: vx += instr.nn; break;
+        case Chip8::OP_8XY0: vx = vy; break;
+        case Chip8::OP_8XY1: vx |= vy; break;
+        case Chip8::OP_8XY2: vx &= vy; break;
+        case Chip8::OP_8XY3: vx ^= vy; break;
+        case Chip8::OP_8XY4: vf = vx + vy > 255; vx += vy; break;
+        case Chip8::OP_8XY5: vf = vx > vy; vx -= vy; break;
+        case Chip8::OP_8XY6: vf = vx & 1; vx >>= 1; break;
+        case Chip8::OP_8XY7: vf = vy > vx; vx = vy - vx; break;
+        case Chip8::OP_8XYE: vf = vx >> 7; vx <<= 1; break;
+        case Chip8::OP_9XY0: pc += vx != vy ? 2 : 0; break;
+        case Chip8::OP_ANNN: indexReg = instr.nnn; break;
+        case Chip8::OP_BNNN: pc = lanes.registers[0][lane] + instr.nnn; break;
+        case Chip8::OP_CXNN: vx = lanes.rng[lane].next() & instr.nn; break;
+        case Chip8::OP_DXYN: vf = display.draw(1, hires, vx, vy, memory, indexReg, 0xFFF, instr.n, false); break;
+        case Chip8::OP_DXY0: vf = display.draw(1, hires, vx, vy, memory, indexReg, 0xFFF, 16, true); break;
+        case Chip8::OP_00CN: display.scrollDown(1, hires, instr.n); break;
+        case Chip8::OP_00FB: display.scrollRight(1, hires); break;
+        case Chip8::OP_00FC: display.scrollLeft(1, hires); break;
+        case Chip8::OP_00FD: pc -= 2; break;
+        case Chip8::OP_00FE: lanes.hires[lane] = 0; display.clear(); break;
+        case Chip8::OP_00FF: lanes.hires[lane] = 1; display.clear(); break;
+        case Chip8::OP_EX9E: pc += keys & (1 << (vx & 0xF)) ? 2 : 0; break;
+        case Chip8::OP_EXA1: pc += keys & (1 << (vx & 0xF)) ? 0 : 2; break;
+        case Chip8::OP_FX07: vx = lanes.delayTimer[lane]; break;
+        case Chip8::OP_FX0A: {
+            if (keys) {
+                uint8_t key = 0;
+
+                while (!(keys & (1 << key))) {
+                    key++;
+                }
+
+                vx = key;
+                lanes.keyWait[lane] = Chip8::NO_KEY_WAIT;
+            } else {
+                lanes.keyWait[lane] = instr.x;
+                pc -= 2;
+            }
+            break;
+        }
+        case Chip8::OP_FX15: lanes.delayTimer[lane] = vx; break;
+        case Chip8::OP_FX18: lanes.soundTimer[lane] = vx; break;
+        case Chip8::OP_FX1E: indexReg += vx; break;
+        case Chip8::OP_FX29: indexReg = 0x50 + 5 * vx; break;
+        case Chip8::OP_FX30: indexReg = 0xA0 + 10 * vx; break;
+        case Chip8::OP_FX33:
+            writeMemory(lane, indexReg, vx / 100);
+            writeMemory(lane, indexReg + 1, vx / 10 % 10);
+            writeMemory(lane, indexReg + 2, vx % 10);
+            break;
+        case Chip8::OP_FX55:
+            for (unsigned int i = 0; i <= instr.x; ++i) {
+                writeMemory(lane, indexReg + i, lanes.registers[i][lane]);
+            }
+            break;
+        case Chip8::OP_FX65:
+            for (unsigned int i = 0; i <= instr.x; ++i) {
+                lanes.registers[i][lane] = memory[(indexReg + i) & 0xFFF];
+            }
+            break;
+        case Chip8::OP_FX75:
+            for (unsigned int i = 0; i <= instr.x; ++i) {
+                rplFlags[i] = lanes.registers[i][lane];
+            }
+            break;
+        case Chip8::OP_FX85:
+            for (unsigned int i = 0; i <= instr.x; ++i) {
+                lanes.registers[i][lane] = rplFlags[i];
+            }
+            break;
+        default:
+            trap(lane);
+            break;
+    }
+}
+
+// Parks the lane on the offending instruction and stops it, like
+// Chip8::op_INVALID; also taken on stack overflow and underflow
+void LockstepEngine::trap(std::size_t lane) {
+    lanes.pc[lane] -= 2;
+    lanes.trapped[lane] = 1;
+}
+
+void LockstepEngine::seed(std::size_t lane, uint64_t value) {
+    lanes.rng[lane].seed(value);
+}
+
+// Same as Chip8::setKey, including waking a lane that waits in FX0A
+void LockstepEngine::setKey(std::size_t lane, uint8_t key, bool pressed) {
+    key &= 0xF;
+
+    if (!pressed) {
+        lanes.keys[lane] &= ~(1 << key);
+        return;
+    }
+
+    lanes.keys[lane] |= 1 << key;
+
+    if (lanes.keyWait[lane] != Chip8::NO_KEY_WAIT) {
+        lanes.registers[lanes.keyWait[lane]][lane] = key;
+        lanes.keyWait[lane] = Chip8::NO_KEY_WAIT;
+        lanes.pc[lane] += 2;
+    }
+}
+
+std::size_t LockstepEngine::getLaneCount() const {
+    return laneCount;
+}
+
+bool LockstepEngine::isTrapped(std::size_t lane) const {
+    return lanes.trapped[lane] != 0;
+}
+
+const char* LockstepEngine::getKernelName() const {
+    return kernelName;
+}
+
+uint64_t LockstepEngine::stateHash(std::size_t lane) const {
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    auto mix = [&hash](const void* data, std::size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+        }
+    };
+
+    mix(&lanes.memory[lane * LaneArrays::MEMORY_SIZE], LaneArrays::MEMORY_SIZE);
+
+    for (const std::vector<uint8_t>& reg : lanes.registers) {
+        mix(&reg[lane], 1);
+    }
+
+    mix(&lanes.stack[lane * LaneArrays::STACK_SIZE], LaneArrays::STACK_SIZE * sizeof(uint16_t));
+    mix(&lanes.keys[lane], sizeof(uint16_t));
+    mix(&lanes.keyWait[lane], 1);
+    mix(lanes.display[lane].planes, sizeof(Display::planes));
+    mix(&lanes.rplFlags[lane * LaneArrays::RPL_FLAGS], LaneArrays::RPL_FLAGS);
+    mix(&lanes.hires[lane], 1);
+    mix(&lanes.sp[lane], 1);
+    mix(&lanes.delayTimer[lane], 1);
+    mix(&lanes.soundTimer[lane], 1);
+    mix(&lanes.indexReg[lane], sizeof(uint16_t));
+    mix(&lanes.pc[lane], sizeof(uint16_t));
+    mix(&lanes.trapped[lane], 1);
+    return hash;
+}
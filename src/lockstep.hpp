@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "display.hpp"
+#include "instruction.hpp"
+#include "romimage.hpp"
+#include "xorshift.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define CHIP8_LOCKSTEP_X64 1
+#else
+    #define CHIP8_LOCKSTEP_X64 0
+#endif
+
+// State of every lane, one array per field. Per-lane fields that are arrays
+// themselves (memory, stack, display, RPL flags) are stored lane after lane.
+struct LaneArrays {
+    static const std::size_t MEMORY_SIZE = 4096;
+    static const std::size_t STACK_SIZE = 16;
+    static const std::size_t RPL_FLAGS = 16;
+
+    std::size_t count;                      // Padded to a multiple of VECTOR_WIDTH
+
+    std::vector<uint8_t> registers[16];
+    std::vector<uint16_t> indexReg;
+    std::vector<uint16_t> pc;
+    std::vector<uint8_t> sp;
+    std::vector<uint8_t> delayTimer;
+    std::vector<uint8_t> soundTimer;
+    std::vector<uint8_t> trapped;
+    std::vector<uint16_t> stack;
+    std::vector<uint8_t> memory;
+    std::vector<Display> display;
+    std::vector<uint8_t> hires;
+    std::vector<uint8_t> rplFlags;
+    std::vector<uint16_t> keys;
+    std::vector<uint8_t> keyWait;
+    std::vector<Xorshift> rng;
+
+    std::vector<uint8_t> scratch;           // Per-lane results handed from a vector kernel to the pc update
+};
+
+// Runs many instances of the same ROM in lockstep. Every step() advances each
+// lane by exactly one instruction: lanes are grouped by pc, and each group runs
+// its instruction through AVX2 or SSE2 kernels with the other lanes masked
+// off. Instructions without a kernel, and code some lane has written to, fall
+// back to a scalar per-lane path with the same semantics as the 4 KB Chip8
+// core, which is the only one lanes emulate.
+class LockstepEngine {
+    public:
+        static const std::size_t VECTOR_WIDTH = 32;
+
+        explicit LockstepEngine(std::size_t lanes);
+
+        // Loads the ROM into every lane; false if it can't be read or doesn't fit in 4 KB
+        bool loadROM(char const* filename);
+        bool loadROM(const RomImage& rom);
+
+        void step();
+        void run(unsigned long long cycles);
+        void tickTimers();
+
+        void seed(std::size_t lane, uint64_t value);
+        void setKey(std::size_t lane, uint8_t key, bool pressed);
+
+        std::size_t getLaneCount() const;
+        bool isTrapped(std::size_t lane) const;
+
+        // Same hash as Chip8::stateHash() for an instance in the same state
+        uint64_t stateHash(std::size_t lane) const;
+
+        // Name of the vector kernels in use: "avx2", "sse2" or "scalar"
+        const char* getKernelName() const;
+
+    private:
+        typedef bool (*VectorKernel)(LaneArrays& lanes, const Instruction& instr, const uint8_t* mask);
+
+        LaneArrays lanes;
+        std::size_t laneCount;                  // Lanes in use, the rest are padding and never run
+        uint8_t image[LaneArrays::MEMORY_SIZE]; // What every lane's memory started as
+        bool written[LaneArrays::MEMORY_SIZE];  // Addresses some lane has stored to since loading
+        std::vector<uint8_t> pending;           // Lanes still to run this step
+        std::vector<uint8_t> mask;              // Lanes in the group being run
+        VectorKernel kernel;
+        const char* kernelName;
+
+        bool executeMasked(const Instruction& instr);
+        void executeLane(std::size_t lane, const Instruction& instr);
+        void writeMemory(std::size_t lane, unsigned int address, uint8_t value);
+        void trap(std::size_t lane);
+        uint16_t fetch(std::size_t lane) const;
+};
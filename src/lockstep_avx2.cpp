@@ -0,0 +1,47 @@
+// AVX2 kernels, only called after a runtime CPU check. The target attribute
+// keeps AVX2 out of everything else in this file, including inline functions
+// shared with other translation units.
+#include "lockstep.hpp"
+
+#if CHIP8_LOCKSTEP_X64
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+    #define LOCKSTEP_TARGET __attribute__((target("avx2")))
+#else
+    #define LOCKSTEP_TARGET
+#endif
+
+namespace {
+    struct Vec {
+        typedef __m256i type;
+        static const std::size_t WIDTH = 32;
+
+        LOCKSTEP_TARGET static type load(const uint8_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+        LOCKSTEP_TARGET static void store(uint8_t* p, type a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a); }
+        LOCKSTEP_TARGET static type set1(uint8_t value) { return _mm256_set1_epi8(static_cast<char>(value)); }
+        LOCKSTEP_TARGET static type blend(type a, type b, type mask) { return _mm256_blendv_epi8(a, b, mask); }
+        LOCKSTEP_TARGET static type add(type a, type b) { return _mm256_add_epi8(a, b); }
+        LOCKSTEP_TARGET static type addSaturate(type a, type b) { return _mm256_adds_epu8(a, b); }
+        LOCKSTEP_TARGET static type sub(type a, type b) { return _mm256_sub_epi8(a, b); }
+        LOCKSTEP_TARGET static type max(type a, type b) { return _mm256_max_epu8(a, b); }
+        LOCKSTEP_TARGET static type equal(type a, type b) { return _mm256_cmpeq_epi8(a, b); }
+        LOCKSTEP_TARGET static type bitOr(type a, type b) { return _mm256_or_si256(a, b); }
+        LOCKSTEP_TARGET static type bitAnd(type a, type b) { return _mm256_and_si256(a, b); }
+        LOCKSTEP_TARGET static type bitXor(type a, type b) { return _mm256_xor_si256(a, b); }
+        LOCKSTEP_TARGET static type andNot(type a, type b) { return _mm256_andnot_si256(a, b); }  // ~a & b
+
+        // There are no byte shifts, so shift words and mask off what crossed between bytes
+        LOCKSTEP_TARGET static type shiftRight1(type a) { return _mm256_and_si256(_mm256_srli_epi16(a, 1), set1(0x7F)); }
+        LOCKSTEP_TARGET static type shiftRight7(type a) { return _mm256_and_si256(_mm256_srli_epi16(a, 7), set1(0x01)); }
+    };
+}
+
+#include "lockstep_kernels.hpp"
+
+namespace lockstep_avx2 {
+    LOCKSTEP_TARGET bool execute(LaneArrays& lanes, const Instruction& instr, const uint8_t* mask) {
+        return executeVector<Vec>(lanes, instr, mask);
+    }
+}
+#endif
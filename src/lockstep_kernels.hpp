@@ -0,0 +1,138 @@
+#pragma once
+
+// Vector kernels of LockstepEngine, written once against a Vec traits class
+// and compiled once per instruction set (see lockstep_avx2.cpp and
+// lockstep_sse2.cpp). Each kernel walks the lanes Vec::WIDTH at a time and
+// blends its results into the lanes set in mask (0xFF or 0x00 per lane).
+// LOCKSTEP_TARGET must be defined by the including file.
+
+#include "chip8.hpp"
+#include "lockstep.hpp"
+
+namespace {
+    template <class Vec>
+    LOCKSTEP_TARGET inline void storeMasked(uint8_t* dst, typename Vec::type value, typename Vec::type mask) {
+        Vec::store(dst, Vec::blend(Vec::load(dst), value, mask));
+    }
+
+    template <class Vec>
+    LOCKSTEP_TARGET bool executeVector(LaneArrays& lanes, const Instruction& instr, const uint8_t* mask) {
+        typedef typename Vec::type V;
+
+        uint8_t* vx = lanes.registers[instr.x].data();
+        uint8_t* vy = lanes.registers[instr.y].data();
+        uint8_t* vf = lanes.registers[0xF].data();
+        uint8_t* skip = lanes.scratch.data();
+        const std::size_t count = lanes.count;
+        const V one = Vec::set1(1);
+        const V nn = Vec::set1(instr.nn);
+
+        switch (instr.op) {
+            case Chip8::OP_6XNN:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    storeMasked<Vec>(vx + i, nn, Vec::load(mask + i));
+                }
+                return true;
+            case Chip8::OP_7XNN:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    storeMasked<Vec>(vx + i, Vec::add(Vec::load(vx + i), nn), Vec::load(mask + i));
+                }
+                return true;
+            case Chip8::OP_8XY0:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    storeMasked<Vec>(vx + i, Vec::load(vy + i), Vec::load(mask + i));
+                }
+                return true;
+            case Chip8::OP_8XY1:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    storeMasked<Vec>(vx + i, Vec::bitOr(Vec::load(vx + i), Vec::load(vy + i)), Vec::load(mask + i));
+                }
+                return true;
+            case Chip8::OP_8XY2:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    storeMasked<Vec>(vx + i, Vec::bitAnd(Vec::load(vx + i), Vec::load(vy + i)), Vec::load(mask + i));
+                }
+                return true;
+            case Chip8::OP_8XY3:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    storeMasked<Vec>(vx + i, Vec::bitXor(Vec::load(vx + i), Vec::load(vy + i)), Vec::load(mask + i));
+                }
+                return true;
+
+            // VF is written before the result, and VX and VY reloaded after, so
+            // X or Y being F behaves exactly like the scalar handlers
+            case Chip8::OP_8XY4:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    V m = Vec::load(mask + i);
+                    V a = Vec::load(vx + i);
+                    V b = Vec::load(vy + i);
+                    // The saturating sum only differs from the wrapping one on a carry
+                    V noCarry = Vec::equal(Vec::addSaturate(a, b), Vec::add(a, b));
+                    storeMasked<Vec>(vf + i, Vec::andNot(noCarry, one), m);
+                    storeMasked<Vec>(vx + i, Vec::add(Vec::load(vx + i), Vec::load(vy + i)), m);
+                }
+                return true;
+            case Chip8::OP_8XY5:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    V m = Vec::load(mask + i);
+                    V a = Vec::load(vx + i);
+                    V b = Vec::load(vy + i);
+                    V greater = Vec::andNot(Vec::equal(a, b), Vec::equal(Vec::max(a, b), a));
+                    storeMasked<Vec>(vf + i, Vec::bitAnd(greater, one), m);
+                    storeMasked<Vec>(vx + i, Vec::sub(Vec::load(vx + i), Vec::load(vy + i)), m);
+                }
+                return true;
+            case Chip8::OP_8XY6:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    V m = Vec::load(mask + i);
+                    storeMasked<Vec>(vf + i, Vec::bitAnd(Vec::load(vx + i), one), m);
+                    storeMasked<Vec>(vx + i, Vec::shiftRight1(Vec::load(vx + i)), m);
+                }
+                return true;
+            case Chip8::OP_8XY7:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    V m = Vec::load(mask + i);
+                    V a = Vec::load(vx + i);
+                    V b = Vec::load(vy + i);
+                    V greater = Vec::andNot(Vec::equal(a, b), Vec::equal(Vec::max(a, b), b));
+                    storeMasked<Vec>(vf + i, Vec::bitAnd(greater, one), m);
+                    storeMasked<Vec>(vx + i, Vec::sub(Vec::load(vy + i), Vec::load(vx + i)), m);
+                }
+                return true;
+            case Chip8::OP_8XYE:
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    V m = Vec::load(mask + i);
+                    storeMasked<Vec>(vf + i, Vec::shiftRight7(Vec::load(vx + i)), m);
+                    V a = Vec::load(vx + i);
+                    storeMasked<Vec>(vx + i, Vec::add(a, a), m);
+                }
+                return true;
+
+            // Skips compare in vectors and leave the extra pc step in scratch for the 16-bit pcs
+            case Chip8::OP_3XNN:
+            case Chip8::OP_4XNN:
+            case Chip8::OP_5XY0:
+            case Chip8::OP_9XY0: {
+                bool negate = instr.op == Chip8::OP_4XNN || instr.op == Chip8::OP_9XY0;
+                bool compareRegisters = instr.op == Chip8::OP_5XY0 || instr.op == Chip8::OP_9XY0;
+                const V two = Vec::set1(2);
+
+                for (std::size_t i = 0; i < count; i += Vec::WIDTH) {
+                    V equal = Vec::equal(Vec::load(vx + i), compareRegisters ? Vec::load(vy + i) : nn);
+                    V taken = negate ? Vec::andNot(equal, Vec::load(mask + i)) : Vec::bitAnd(equal, Vec::load(mask + i));
+                    Vec::store(skip + i, Vec::bitAnd(taken, two));
+                }
+
+                uint16_t* pc = lanes.pc.data();
+
+                for (std::size_t i = 0; i < count; ++i) {
+                    pc[i] += skip[i];
+                }
+                return true;
+            }
+
+            default:
+                return false;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+// SSE2 kernels, always available on x86-64
+#include "lockstep.hpp"
+
+#if CHIP8_LOCKSTEP_X64
+#include <emmintrin.h>
+
+#define LOCKSTEP_TARGET
+
+namespace {
+    struct Vec {
+        typedef __m128i type;
+        static const std::size_t WIDTH = 16;
+
+        static type load(const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+        static void store(uint8_t* p, type a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a); }
+        static type set1(uint8_t value) { return _mm_set1_epi8(static_cast<char>(value)); }
+        static type blend(type a, type b, type mask) { return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a)); }
+        static type add(type a, type b) { return _mm_add_epi8(a, b); }
+        static type addSaturate(type a, type b) { return _mm_adds_epu8(a, b); }
+        static type sub(type a, type b) { return _mm_sub_epi8(a, b); }
+        static type max(type a, type b) { return _mm_max_epu8(a, b); }
+        static type equal(type a, type b) { return _mm_cmpeq_epi8(a, b); }
+        static type bitOr(type a, type b) { return _mm_or_si128(a, b); }
+        static type bitAnd(type a, type b) { return _mm_and_si128(a, b); }
+        static type bitXor(type a, type b) { return _mm_xor_si128(a, b); }
+        static type andNot(type a, type b) { return _mm_andnot_si128(a, b); }  // ~a & b
+
+        // There are no byte shifts, so shift words and mask off what crossed between bytes
+        static type shiftRight1(type a) { return _mm_and_si128(_mm_srli_epi16(a, 1), set1(0x7F)); }
+        static type shiftRight7(type a) { return _mm_and_si128(_mm_srli_epi16(a, 7), set1(0x01)); }
+    };
+}
+
+#include "lockstep_kernels.hpp"
+
+namespace lockstep_sse2 {
+    bool execute(LaneArrays& lanes, const Instruction& instr, const uint8_t* mask) {
+        return executeVector<Vec>(lanes, instr, mask);
+    }
+}
+#endif
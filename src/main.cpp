@@ -1,37 +1,217 @@
 #include "chip8.hpp"
 #include "graphics.hpp"
+#include "emulation.hpp"
+#include "recording.hpp"
+#include "quirks.hpp"
+#include "profiler.hpp"
+#include "keymap.hpp"
+#include "framepacer.hpp"
+#include "audio.hpp"
+#include <cstring>
 
 int main(int argc, char **argv) {
-    const unsigned int VIDEO_WIDTH = 64;
-    const unsigned int VIDEO_HEIGHT = 32;
-    int pitch;
+    const unsigned int VIDEO_WIDTH = Display::WIDTH;
+    const unsigned int VIDEO_HEIGHT = Display::HEIGHT;
     bool quit = false;
+    const char* filename = nullptr;
+    const char* recordFilename = nullptr;
+    const char* keymapFilename = nullptr;
+    FramePacer::Mode pacing = FramePacer::Mode::Latency;
+    unsigned long long maxFrames = 0;
+    unsigned int instructionsPerSecond = Scheduler::DEFAULT_IPS;
+    InputRecording recording;
+    bool seeded = false;
+    bool xoChip = false;
+    bool quirksGiven = false;
+    QuirkProfile profile = QuirkProfile::Default;
+    QuirkDatabase quirkDatabase;
 
-    if (argc != 2) {
-        std::cout << "Insufficient arguments. Usage: " << argv[0] << " <path to rom>\n";
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            recording.seed = std::strtoull(argv[++i], nullptr, 10);
+            seeded = true;
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordFilename = argv[++i];
+        } else if (std::strcmp(argv[i], "--keymap") == 0 && i + 1 < argc) {
+            keymapFilename = argv[++i];
+        } else if (std::strcmp(argv[i], "--pacing") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+
+            if (std::strcmp(mode, "smooth") == 0) {
+                pacing = FramePacer::Mode::Smooth;
+            } else if (std::strcmp(mode, "latency") == 0) {
+                pacing = FramePacer::Mode::Latency;
+            } else {
+                std::cout << "Unknown pacing mode: " << mode << '\n';
+                std::exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            maxFrames = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--xo") == 0) {
+            xoChip = true;
+        } else if (std::strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            if (!parseQuirkProfile(argv[++i], profile)) {
+                std::cout << "Unknown quirk profile: " << argv[i] << '\n';
+                std::exit(1);
+            }
+
+            quirksGiven = true;
+        } else if (std::strcmp(argv[i], "--quirk-db") == 0 && i + 1 < argc) {
+            if (!quirkDatabase.load(argv[++i])) {
+                std::cout << "Could not read quirk database: " << argv[i] << '\n';
+                std::exit(1);
+            }
+        } else if (!filename) {
+            filename = argv[i];
+        } else {
+            instructionsPerSecond = std::strtoul(argv[i], nullptr, 10);
+        }
+    }
+
+    if (!filename) {
+        std::cout << "Insufficient arguments. Usage: " << argv[0]
+                  << " [--seed N] [--record file] [--keymap file] [--pacing latency|smooth] [--frames N] [--xo] [--quirks default|cosmac|schip|xochip] [--quirk-db file] <path to rom> [instructions per second]\n";
         std::exit(0);
     }
 
-    const char* filename = argv[1];
-    Chip8 chip8;
-    Graphics* graphics = new Graphics("CHIP-8 Emulator by Jonathan Sohrabi", VIDEO_WIDTH*4, VIDEO_HEIGHT*4, VIDEO_WIDTH, VIDEO_HEIGHT);
+    // A recording always has a seed, so it can be replayed
+    if (recordFilename && !seeded) {
+        recording.seed = std::chrono::system_clock::now().time_since_epoch().count();
+        seeded = true;
+    }
+
+    Keymap keymap;
+
+    if (keymapFilename && !keymap.load(keymapFilename)) {
+        std::cout << "Could not read keymap: " << keymapFilename << '\n';
+        std::exit(1);
+    }
+
+    // A ROM the database lists gets its profile, others the one given or the usual one for the core
+    if (!quirksGiven && xoChip) {
+        profile = QuirkProfile::XoChip;
+    }
 
-    chip8.loadROM(filename);
+    RomImage::Status romStatus;
+    std::shared_ptr<const RomImage> rom = RomImage::open(filename, xoChip ? 0x10000 : 0x1000, &romStatus);
 
-    pitch = sizeof(chip8.display[0]) * VIDEO_WIDTH;
+    if (!rom) {
+        std::cout << (romStatus == RomImage::Status::TooLarge ? "ROM too large for memory: " : "Could not open ROM: ") << filename << '\n';
+        std::exit(1);
+    }
 
-    auto lastCycleTime = std::chrono::high_resolution_clock::now();
+    quirkDatabase.lookup(rom->getHash(), profile);
+
+    std::unique_ptr<Chip8> chip8 = Chip8::create(xoChip, profile);
+
+    recording.xoChip = xoChip;
+    recording.quirkProfile = profile;
+
+    if (seeded) {
+        chip8->seed(recording.seed);
+    }
+
+    Graphics* graphics = new Graphics("CHIP-8 Emulator by Jonathan Sohrabi", VIDEO_WIDTH*2, VIDEO_HEIGHT*2, VIDEO_WIDTH, VIDEO_HEIGHT,
+                                      pacing == FramePacer::Mode::Smooth);
+    graphics->setKeymap(keymap);
+    chip8->loadROM(*rom);
+
+    Audio audio;
+    bool sound = audio.isOpen();
+    EmulationThread emulation(*chip8, instructionsPerSecond);
+    FramePacer pacer(pacing, graphics->getRefreshRate(), graphics->hasVsync());
+    std::vector<KeyEvent> events;
+    Display shown;                      // The display as last presented
+    bool shownHires = false;
+    bool firstFrame = true;
+
+    // Emulation runs on its own thread. This one only handles input and presents frames.
+    emulation.setRecording(recordFilename ? &recording : nullptr);
+    emulation.setSoundChannel(sound ? &audio.getChannel() : nullptr);
+    emulation.start();
 
     while (!quit) {
-        quit = graphics->input(chip8.keyPressedState);
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float timeElapsedInCycle = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
-        
-        if (timeElapsedInCycle > 10) {
-            lastCycleTime = currentTime;
-            chip8.cycle();
-            graphics->updateScreen(chip8.display, pitch);
+        events.clear();
+        quit = graphics->input(events);
+
+        for (const KeyEvent& event : events) {
+            if (!emulation.pushKey(event)) {
+                std::cout << "Input queue full, key event dropped\n";
+            }
+        }
+
+        emulation.setRewinding(graphics->isRewinding());
+
+        bool fresh = emulation.updateFrame();
+        const EmulationThread::Frame& frame = emulation.getFrame();
+        uint64_t dirtyRows = 0;
+
+        if (fresh) {
+            pacer.received(frame.number);
+            dirtyRows = firstFrame || frame.hires != shownHires ? ~0ull : 0;
+            firstFrame = false;
+
+            // Frames the emulator published in between were never shown, so rows are diffed against the last one that was
+            for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row) {
+                dirtyRows |= static_cast<uint64_t>(frame.display.rowDiffers(shown, row)) << row;
+            }
+
+            dirtyRows &= Display::allRows(Display::height(frame.hires));
+            shown = frame.display;
+            shownHires = frame.hires;
+        }
+
+        // Lowest-latency pacing skips the upload and present for frames that change nothing
+        if (pacer.shouldPresent(fresh && dirtyRows)) {
+            graphics->updateScreen(frame.display, frame.hires, dirtyRows);
+            pacer.presented(frame.time, fresh);
+
+            if (pacer.alignsFrames()) {
+                emulation.alignFrames(pacer.getLastPresent(), pacer.getRefreshPeriod());
+            }
         }
+
+        if (emulation.hasTrapped()) {
+            std::cout << "Invalid opcode " << std::hex << std::setw(4) << std::setfill('0') << chip8->getTrapOpcode()
+                      << " at " << std::setw(3) << chip8->getTrapAddress() << std::dec << '\n';
+            quit = true;
+        }
+
+        if (maxFrames && pacer.getPresentCount() >= maxFrames) {
+            quit = true;
+        }
+
+        pacer.wait();
+    }
+
+    emulation.stop();
+    audio.close();
+
+    if (recordFilename) {
+        recording.instructionsPerSecond = instructionsPerSecond;
+        recording.cycles = emulation.getCycleCount();
+        recording.finalHash = chip8->stateHash();
+
+        if (!recording.save(recordFilename)) {
+            std::cout << "Could not write recording: " << recordFilename << '\n';
+        }
+    }
+
+    // Input-to-frame latency: from SDL receiving a key to the publish of the first frame that used it
+    if (emulation.getInputCount() > 0) {
+        std::cout << "Input latency: " << emulation.getInputCount() << " key events, "
+                  << std::chrono::duration<double, std::milli>(emulation.getInputLatencyTotal()).count() / emulation.getInputCount() << " ms mean, "
+                  << std::chrono::duration<double, std::milli>(emulation.getInputLatencyMax()).count() << " ms max\n";
+    }
+
+    pacer.writeReport(std::cout);
+
+    if (sound) {
+        audio.writeReport(std::cout);
+    }
+
+    if (chip8->getProfiler()) {
+        chip8->getProfiler()->dump("profile.json");
     }
 
     delete graphics;
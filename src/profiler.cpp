@@ -0,0 +1,99 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <vector>
+
+namespace {
+    // Indices of the non-zero counts, highest count first
+    std::vector<unsigned int> sortedByCount(const unsigned long long* counts, unsigned int size) {
+        std::vector<unsigned int> order;
+
+        for (unsigned int i = 0; i < size; ++i) {
+            if (counts[i]) {
+                order.push_back(i);
+            }
+        }
+
+        std::stable_sort(order.begin(), order.end(), [counts](unsigned int a, unsigned int b) {
+            return counts[a] > counts[b];
+        });
+
+        return order;
+    }
+}
+
+Profiler::Profiler() {
+    reset();
+}
+
+void Profiler::reset() {
+    std::fill(opCounts, opCounts+Chip8::OP_COUNT, 0);
+    std::fill(pcCounts, pcCounts+MEMORY_SIZE, 0);
+    std::fill(pcOps, pcOps+MEMORY_SIZE, Chip8::OP_INVALID);
+    draws = 0;
+    drawRows = 0;
+    drawPixels = 0;
+}
+
+unsigned long long Profiler::getInstructionCount() const {
+    return std::accumulate(opCounts, opCounts+Chip8::OP_COUNT, 0ull);
+}
+
+void Profiler::writeReport(std::ostream& out) const {
+    unsigned long long total = std::max(getInstructionCount(), 1ull);
+    std::vector<unsigned int> ops = sortedByCount(opCounts, Chip8::OP_COUNT);
+    std::vector<unsigned int> addresses = sortedByCount(pcCounts, MEMORY_SIZE);
+    std::ios format(nullptr);
+
+    format.copyfmt(out);
+    out << "Instructions: " << getInstructionCount() << '\n';
+    out << std::fixed << std::setprecision(2);
+
+    for (unsigned int op : ops) {
+        out << "  " << std::setw(7) << std::left << Chip8::opName(op) << std::right
+            << std::setw(14) << opCounts[op] << std::setw(8) << 100.0 * opCounts[op] / total << "%\n";
+    }
+
+    out << "Hottest addresses:\n";
+
+    for (std::size_t i = 0; i < addresses.size() && i < TOP_ADDRESSES; ++i) {
+        unsigned int pc = addresses[i];
+        out << "  " << std::hex << std::setw(3) << std::setfill('0') << pc << std::dec << std::setfill(' ')
+            << ' ' << std::setw(7) << std::left << Chip8::opName(pcOps[pc]) << std::right
+            << std::setw(14) << pcCounts[pc] << std::setw(8) << 100.0 * pcCounts[pc] / total << "%\n";
+    }
+
+    out << "Draws: " << draws << ", " << drawRows << " rows, " << drawPixels << " pixels\n";
+    out.copyfmt(format);
+}
+
+void Profiler::writeJson(std::ostream& out) const {
+    std::vector<unsigned int> ops = sortedByCount(opCounts, Chip8::OP_COUNT);
+    std::vector<unsigned int> addresses = sortedByCount(pcCounts, MEMORY_SIZE);
+
+    out << "{\n  \"instructions\": " << getInstructionCount() << ",\n  \"opcodes\": {";
+
+    for (std::size_t i = 0; i < ops.size(); ++i) {
+        out << (i ? ", " : "") << '"' << Chip8::opName(ops[i]) << "\": " << opCounts[ops[i]];
+    }
+
+    out << "},\n  \"addresses\": [";
+
+    for (std::size_t i = 0; i < addresses.size(); ++i) {
+        unsigned int pc = addresses[i];
+        out << (i ? ",\n    " : "\n    ") << "{\"pc\": " << pc << ", \"op\": \"" << Chip8::opName(pcOps[pc])
+            << "\", \"count\": " << pcCounts[pc] << '}';
+    }
+
+    out << "\n  ],\n  \"draws\": {\"count\": " << draws << ", \"rows\": " << drawRows
+        << ", \"pixels\": " << drawPixels << "}\n}\n";
+}
+
+void Profiler::dump(const char* jsonFilename) const {
+    std::ofstream file(jsonFilename);
+
+    writeReport(std::cout);
+    writeJson(file);
+    std::cout << "Profile written to " << jsonFilename << '\n';
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include "chip8.hpp"
+
+// Execution counts per instruction and per address, plus draw volume. Only
+// filled in by builds configured with CHIP8_PROFILE=ON; see Chip8::PROFILING.
+class Profiler {
+    public:
+        static const unsigned int MEMORY_SIZE = 0x10000;         // Enough for the XO-CHIP core
+        static const unsigned int TOP_ADDRESSES = 20;      // Addresses listed in the text report
+
+        Profiler();
+
+        void count(uint16_t pc, const Instruction& instr) {
+            opCounts[instr.op]++;
+            pcCounts[pc & (MEMORY_SIZE - 1)]++;
+            pcOps[pc & (MEMORY_SIZE - 1)] = instr.op;
+        }
+
+        void countDraw(unsigned int rows, unsigned int pixels) {
+            draws++;
+            drawRows += rows;
+            drawPixels += pixels;
+        }
+
+        void reset();
+        unsigned long long getInstructionCount() const;
+
+        // Sorted by count, most executed first
+        void writeReport(std::ostream& out) const;
+        void writeJson(std::ostream& out) const;
+
+        // Prints the report and writes the JSON next to it, for tools to call when a run ends
+        void dump(const char* jsonFilename) const;
+
+    private:
+        unsigned long long opCounts[Chip8::OP_COUNT];
+        unsigned long long pcCounts[MEMORY_SIZE];
+        uint8_t pcOps[MEMORY_SIZE];                 // Instruction last seen at each address
+        unsigned long long draws;
+        unsigned long long drawRows;                // Sprite rows drawn, after clipping, on each plane drawn
+        unsigned long long drawPixels;              // Lit sprite pixels XORed onto the display
+};
@@ -0,0 +1,119 @@
+#include "quirks.hpp"
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+namespace {
+    // Indexed by QuirkProfile
+    const char* const PROFILE_NAMES[QUIRK_PROFILE_COUNT] = { "default", "cosmac", "schip", "xochip" };
+}
+
+const char* quirkProfileName(QuirkProfile profile) {
+    unsigned int index = static_cast<unsigned int>(profile);
+
+    return index < QUIRK_PROFILE_COUNT ? PROFILE_NAMES[index] : "unknown";
+}
+
+bool parseQuirkProfile(const std::string& name, QuirkProfile& profile) {
+    for (unsigned int i = 0; i < QUIRK_PROFILE_COUNT; ++i) {
+        if (name == PROFILE_NAMES[i]) {
+            profile = static_cast<QuirkProfile>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool QuirkDatabase::load(const char* filename) {
+    std::ifstream file(filename);
+    std::string line;
+    std::unordered_map<uint64_t, Entry> loaded;
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        uint64_t hash;
+        std::string name;
+        std::string title;
+        QuirkProfile profile;
+
+        if ((fields >> std::ws).eof() || fields.peek() == '#') {
+            continue;
+        }
+
+        if (!(fields >> std::hex >> hash >> name) || !parseQuirkProfile(name, profile)) {
+            return false;
+        }
+
+        // Titles may contain spaces
+        std::getline(fields >> std::ws, title);
+        loaded[hash] = { profile, title };
+    }
+
+    for (const auto& entry : loaded) {
+        entries[entry.first] = entry.second;
+    }
+
+    return true;
+}
+
+void QuirkDatabase::add(uint64_t hash, QuirkProfile profile, const std::string& title) {
+    entries[hash] = { profile, title };
+}
+
+bool QuirkDatabase::lookup(uint64_t hash, QuirkProfile& profile, std::string* title) const {
+    auto entry = entries.find(hash);
+
+    if (entry == entries.end()) {
+        return false;
+    }
+
+    profile = entry->second.profile;
+
+    if (title) {
+        *title = entry->second.title;
+    }
+
+    return true;
+}
+
+QuirkProfile QuirkDatabase::lookupFile(const char* filename, QuirkProfile fallback) const {
+    uint64_t romHash;
+
+    if (hashFile(filename, romHash)) {
+        lookup(romHash, fallback);
+    }
+
+    return fallback;
+}
+
+std::size_t QuirkDatabase::size() const {
+    return entries.size();
+}
+
+uint64_t QuirkDatabase::hash(const uint8_t* data, std::size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    for (std::size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+bool QuirkDatabase::hashFile(const char* filename, uint64_t& hash) {
+    std::ifstream file(filename, std::ios::binary);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    hash = QuirkDatabase::hash(data.data(), data.size());
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+// Behaviour that differs between CHIP-8 interpreters. Each quirk is a tag a
+// Chip8Core lists in its Quirks... parameter pack, and the handlers test for
+// it with if constexpr, so no core checks a quirk at run time. A core with
+// none shifts VX in place, leaves I alone in FX55/FX65, jumps to NNN + V0 and
+// clips sprites at the edges, as this emulator always has.
+struct QuirkShiftVY {           // 8XY6/8XYE shift VY and store the result in VX
+    static const unsigned int BIT = 1 << 0;
+};
+
+struct QuirkIncrementI {        // FX55/FX65 leave I just past the last register
+    static const unsigned int BIT = 1 << 1;
+};
+
+struct QuirkJumpVX {            // BXNN jumps to XNN + VX
+    static const unsigned int BIT = 1 << 2;
+};
+
+struct QuirkWrapSprites {       // Sprites wrap around the edges instead of clipping
+    static const unsigned int BIT = 1 << 3;
+};
+
+template <class Quirk, class... Quirks>
+constexpr bool hasQuirk = (std::is_same_v<Quirk, Quirks> || ...);
+
+template <class... Quirks>
+constexpr unsigned int quirkBits = (0u | ... | Quirks::BIT);
+
+// The quirks of the common interpreters, each run by a core of its own
+enum class QuirkProfile : uint8_t {
+    Default,        // None of them
+    Cosmac,         // The original COSMAC VIP interpreter: ShiftVY, IncrementI
+    SuperChip,      // SUPER-CHIP 1.1 on the HP 48: JumpVX
+    XoChip          // Octo and XO-CHIP: ShiftVY, IncrementI, WrapSprites
+};
+
+const unsigned int QUIRK_PROFILE_COUNT = 4;
+
+// Lower-case names, like "cosmac", as profiles are given on the command line
+const char* quirkProfileName(QuirkProfile profile);
+bool parseQuirkProfile(const std::string& name, QuirkProfile& profile);
+
+// Quirk profiles of known ROMs, keyed by the FNV-1a hash of the ROM image
+class QuirkDatabase {
+    public:
+        // Adds the lines of a database file, each "<hash in hex> <profile>",
+        // optionally followed by a title, e.g. "2f8ae5bbd1e4a7c3 cosmac Pong".
+        // Blank lines and # comments are skipped. Adds nothing and returns
+        // false if the file can't be read or a line doesn't parse.
+        bool load(const char* filename);
+
+        void add(uint64_t hash, QuirkProfile profile, const std::string& title = std::string());
+
+        // False, leaving profile and title alone, for a ROM that isn't listed
+        bool lookup(uint64_t hash, QuirkProfile& profile, std::string* title = nullptr) const;
+
+        // The profile listed for a ROM file, or fallback if it isn't listed or can't be read
+        QuirkProfile lookupFile(const char* filename, QuirkProfile fallback) const;
+
+        std::size_t size() const;
+
+        static uint64_t hash(const uint8_t* data, std::size_t size);
+        static bool hashFile(const char* filename, uint64_t& hash);     // False if the file can't be read
+
+    private:
+        struct Entry {
+            QuirkProfile profile;
+            std::string title;
+        };
+
+        std::unordered_map<uint64_t, Entry> entries;
+};
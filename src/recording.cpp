@@ -0,0 +1,159 @@
+#include "recording.hpp"
+#include "chip8.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    const char MAGIC[4] = { 'C', '8', 'I', 'N' };
+
+    void putInt(std::vector<uint8_t>& out, uint64_t value, unsigned int bytes) {
+        for (unsigned int i = 0; i < bytes; ++i) {
+            out.push_back(value >> (8 * i));
+        }
+    }
+
+    bool getInt(const std::vector<uint8_t>& in, std::size_t& pos, uint64_t& value, unsigned int bytes) {
+        if (in.size() - pos < bytes) {
+            return false;
+        }
+
+        value = 0;
+
+        for (unsigned int i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(in[pos++]) << (8 * i);
+        }
+
+        return true;
+    }
+
+    void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+
+        out.push_back(value);
+    }
+
+    bool getVarint(const std::vector<uint8_t>& in, std::size_t& pos, uint64_t& value) {
+        value = 0;
+
+        for (unsigned int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+            uint8_t byte = in[pos++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+InputRecording::InputRecording() {
+    seed = 0;
+    xoChip = false;
+    quirkProfile = QuirkProfile::Default;
+    instructionsPerSecond = 0;
+    cycles = 0;
+    finalHash = 0;
+}
+
+void InputRecording::record(unsigned long long cycle, uint8_t key, bool pressed) {
+    events.push_back({ cycle, key, pressed });
+}
+
+bool InputRecording::save(const char* filename) const {
+    std::vector<uint8_t> data(MAGIC, MAGIC+4);
+    unsigned long long lastCycle = 0;
+
+    putInt(data, VERSION, 2);
+    putInt(data, seed, 8);
+    putInt(data, xoChip, 1);
+    putInt(data, static_cast<uint8_t>(quirkProfile), 1);
+    putInt(data, instructionsPerSecond, 4);
+    putInt(data, cycles, 8);
+    putInt(data, finalHash, 8);
+    putInt(data, events.size(), 4);
+
+    for (const InputEvent& event : events) {
+        putVarint(data, event.cycle - lastCycle);
+        data.push_back((event.key & 0xF) | (event.pressed ? 0x80 : 0));
+        lastCycle = event.cycle;
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return file.good();
+}
+
+bool InputRecording::load(const char* filename) {
+    std::ifstream file(filename, std::ios::binary);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::size_t pos = 4;
+    uint64_t version, xo, profile, ips, count;
+
+    if (data.size() < 4 || !std::equal(MAGIC, MAGIC+4, data.begin())
+            || !getInt(data, pos, version, 2) || version != VERSION
+            || !getInt(data, pos, seed, 8) || !getInt(data, pos, xo, 1)
+            || !getInt(data, pos, profile, 1) || profile >= QUIRK_PROFILE_COUNT || !getInt(data, pos, ips, 4) || ips == 0
+            || !getInt(data, pos, cycles, 8) || !getInt(data, pos, finalHash, 8)
+            || !getInt(data, pos, count, 4)) {
+        return false;
+    }
+
+    unsigned long long cycle = 0;
+
+    xoChip = xo != 0;
+    quirkProfile = static_cast<QuirkProfile>(profile);
+    instructionsPerSecond = ips;
+    events.clear();
+
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t delta;
+
+        if (!getVarint(data, pos, delta) || pos >= data.size()) {
+            return false;
+        }
+
+        uint8_t byte = data[pos++];
+        cycle += delta;
+        events.push_back({ cycle, static_cast<uint8_t>(byte & 0xF), (byte & 0x80) != 0 });
+    }
+
+    return true;
+}
+
+unsigned long long replayInput(Chip8& chip8, unsigned int instructionsPerSecond,
+                               const std::vector<InputEvent>& events, unsigned long long cycles) {
+    // No frame would ever run an instruction
+    if (instructionsPerSecond == 0) {
+        return 0;
+    }
+
+    // Frames are only used to tick the timers at the emulated rate; nothing sleeps
+    Scheduler scheduler(chip8, instructionsPerSecond);
+    std::size_t nextEvent = 0;
+    unsigned int idleFrames = 0;
+
+    // Below 60 IPS some frames run nothing, but any nonzero rate runs an
+    // instruction within a second of frames; past that the replay is stuck
+    while (scheduler.getCycleCount() < cycles && !chip8.isTrapped() && idleFrames < Scheduler::FRAME_RATE) {
+        while (nextEvent < events.size() && events[nextEvent].cycle <= scheduler.getCycleCount()) {
+            chip8.setKey(events[nextEvent].key, events[nextEvent].pressed);
+            nextEvent++;
+        }
+
+        idleFrames = scheduler.runFrame(cycles - scheduler.getCycleCount()) ? 0 : idleFrames + 1;
+    }
+
+    return scheduler.getCycleCount();
+}
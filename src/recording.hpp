@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "quirks.hpp"
+
+class Chip8;
+
+struct InputEvent {
+    unsigned long long cycle;   // Applied at the start of the first frame at or after this cycle
+    uint8_t key;
+    bool pressed;
+};
+
+// Key changes of a session with everything else needed to reproduce it: the
+// seed, the core it ran on, the instruction rate the frames were paced at, and
+// the length and final state hash to check a replay against.
+//
+// On disk: a "C8IN" magic, a version, the header fields, then one record per
+// change of a LEB128 cycle delta and a byte holding the key in the low
+// nibble and the pressed state in the top bit. Multi-byte header fields are
+// little endian.
+class InputRecording {
+    public:
+        static const uint16_t VERSION = 4;
+
+        uint64_t seed;
+        bool xoChip;                // Ran on the 64 KB XO-CHIP core
+        QuirkProfile quirkProfile;  // The quirks of the core it ran on
+        uint32_t instructionsPerSecond;
+        uint64_t cycles;
+        uint64_t finalHash;
+        std::vector<InputEvent> events;
+
+        InputRecording();
+
+        // Appends an event, in the order the events were applied
+        void record(unsigned long long cycle, uint8_t key, bool pressed);
+
+        bool save(const char* filename) const;
+        bool load(const char* filename);
+};
+
+// Runs chip8 unthrottled in frames paced for instructionsPerSecond, applying
+// each event at the start of its frame the way the frontend polls input,
+// until cycles have run or the machine traps. Returns the cycles run, which
+// is 0 without running anything if instructionsPerSecond is 0.
+unsigned long long replayInput(Chip8& chip8, unsigned int instructionsPerSecond,
+                               const std::vector<InputEvent>& events, unsigned long long cycles);
@@ -0,0 +1,61 @@
+#include "chip8.hpp"
+#include "recording.hpp"
+#include "profiler.hpp"
+#include <cstdlib>
+#include <cstring>
+
+// Replays a session recorded by the frontend with --record, as fast as the
+// host allows, and checks that it ends in the recorded state.
+int main(int argc, char **argv) {
+    Chip8::Dispatch dispatch = Chip8::Dispatch::Jit;
+    std::vector<const char*> filenames;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--interpret") == 0) {
+            dispatch = Chip8::Dispatch::Table;
+        } else {
+            filenames.push_back(argv[i]);
+        }
+    }
+
+    if (filenames.size() != 2) {
+        std::cout << "Usage: " << argv[0] << " [--interpret] <path to rom> <recording>\n";
+        std::exit(0);
+    }
+
+    InputRecording recording;
+
+    if (!recording.load(filenames[1])) {
+        std::cout << "Could not read recording: " << filenames[1] << '\n';
+        std::exit(1);
+    }
+
+    std::unique_ptr<Chip8> chip8 = Chip8::create(recording.xoChip, recording.quirkProfile);
+
+    chip8->seed(recording.seed);
+    chip8->setDispatch(dispatch);
+
+    if (!chip8->loadROM(filenames[0])) {
+        std::cout << "Could not open ROM: " << filenames[0] << '\n';
+        std::exit(1);
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    unsigned long long cycles = replayInput(*chip8, recording.instructionsPerSecond, recording.events, recording.cycles);
+    auto endTime = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(endTime - startTime).count();
+    bool match = cycles == recording.cycles && chip8->stateHash() == recording.finalHash;
+
+    std::cout << "Events:   " << recording.events.size() << '\n';
+    std::cout << "Cycles:   " << cycles << '\n';
+    std::cout << "Seconds:  " << seconds << '\n';
+    std::cout << "IPS:      " << std::fixed << std::setprecision(0) << cycles / seconds << '\n';
+    std::cout << "State:    " << std::hex << std::setw(16) << std::setfill('0') << chip8->stateHash() << std::dec
+              << (match ? " matches the recording\n" : " MISMATCH with the recording\n");
+
+    if (chip8->getProfiler()) {
+        chip8->getProfiler()->dump("profile.json");
+    }
+
+    return match ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#include "rewind.hpp"
+
+namespace {
+    // A literal run only ends at a gap of unchanged bytes at least this long,
+    // since each run costs four bytes of header
+    const std::size_t MIN_GAP = 4;
+
+    void putLength(std::vector<uint8_t>& out, std::size_t length) {
+        out.push_back(length & 0xFF);
+        out.push_back(length >> 8);
+    }
+}
+
+Rewind::Rewind(std::size_t budget) : budget(budget), byteCount(0) {
+}
+
+void Rewind::push(const Chip8& chip8) {
+    Frame frame;
+
+    // Snapshots of a core with a different memory size can't be deltas of each other
+    if (state.size() != chip8.getStateSize()) {
+        clear();
+        state.resize(chip8.getStateSize());
+    }
+
+    chip8.saveState(state.data());
+
+    if (frames.empty() || frames.back().keyframeDistance + 1 >= KEYFRAME_INTERVAL) {
+        frame.keyframeDistance = 0;
+        frame.data = state;
+    } else {
+        frame.keyframeDistance = frames.back().keyframeDistance + 1;
+        const Frame& keyframe = frames[frames.size() - frame.keyframeDistance];
+        encodeDelta(state.data(), keyframe.data.data(), state.size(), frame.data);
+    }
+
+    byteCount += frame.data.size();
+    frames.push_back(std::move(frame));
+
+    // Drop whole keyframe groups from the front, never the one being written to
+    while (byteCount > budget && frames.size() > frames.back().keyframeDistance + 1) {
+        do {
+            byteCount -= frames.front().data.size();
+            frames.pop_front();
+        } while (frames.front().keyframeDistance != 0);
+    }
+}
+
+bool Rewind::stepBack(Chip8& chip8) {
+    if (frames.size() < 2) {
+        return false;
+    }
+
+    byteCount -= frames.back().data.size();
+    frames.pop_back();
+
+    const Frame& frame = frames.back();
+
+    if (frame.keyframeDistance == 0) {
+        return chip8.loadState(frame.data.data(), frame.data.size());
+    }
+
+    const Frame& keyframe = frames[frames.size() - 1 - frame.keyframeDistance];
+    decodeDelta(frame.data, keyframe.data.data(), keyframe.data.size(), state.data());
+    return chip8.loadState(state.data(), state.size());
+}
+
+void Rewind::clear() {
+    frames.clear();
+    byteCount = 0;
+}
+
+std::size_t Rewind::getFrameCount() const {
+    return frames.size();
+}
+
+std::size_t Rewind::getByteCount() const {
+    return byteCount;
+}
+
+// A delta is a list of runs: bytes to skip, length of the literal, then the
+// literal bytes XORed with the keyframe. Lengths are 16-bit little endian.
+void Rewind::encodeDelta(const uint8_t* state, const uint8_t* keyframe, std::size_t size, std::vector<uint8_t>& out) {
+    std::size_t pos = 0;
+
+    out.clear();
+
+    while (pos < size) {
+        std::size_t start = pos;
+
+        while (pos < size && state[pos] == keyframe[pos]) {
+            pos++;
+        }
+
+        if (pos == size) {
+            break;
+        }
+
+        std::size_t literal = pos;
+        std::size_t gap = 0;
+
+        while (pos < size && gap < MIN_GAP) {
+            gap = state[pos] == keyframe[pos] ? gap + 1 : 0;
+            pos++;
+        }
+
+        std::size_t end = pos - gap;
+
+        // Lengths are 16-bit, so a longer skip or literal is split over several runs
+        while (literal - start > 0xFFFF) {
+            putLength(out, 0xFFFF);
+            putLength(out, 0);
+            start += 0xFFFF;
+        }
+
+        while (literal < end) {
+            std::size_t length = std::min<std::size_t>(end - literal, 0xFFFF);
+
+            putLength(out, literal - start);
+            putLength(out, length);
+
+            for (std::size_t i = literal; i < literal + length; ++i) {
+                out.push_back(state[i] ^ keyframe[i]);
+            }
+
+            literal += length;
+            start = literal;
+        }
+
+        pos = end;
+    }
+}
+
+void Rewind::decodeDelta(const std::vector<uint8_t>& delta, const uint8_t* keyframe, std::size_t size, uint8_t* state) {
+    std::size_t pos = 0;
+    std::size_t in = 0;
+
+    std::copy(keyframe, keyframe + size, state);
+
+    while (in < delta.size()) {
+        pos += delta[in] | (delta[in + 1] << 8);
+        std::size_t length = delta[in + 2] | (delta[in + 3] << 8);
+        in += 4;
+
+        for (std::size_t i = 0; i < length; ++i) {
+            state[pos + i] ^= delta[in + i];
+        }
+
+        pos += length;
+        in += length;
+    }
+}
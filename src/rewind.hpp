@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "chip8.hpp"
+
+// Bounded history of per-frame snapshots for stepping a Chip8 back in time.
+// Every KEYFRAME_INTERVAL-th snapshot is kept whole; the ones in between are
+// stored as the run-length encoded XOR against their keyframe, so restoring
+// any frame decodes a single delta. When the history outgrows its byte budget
+// the oldest keyframe is dropped together with its deltas.
+class Rewind {
+    public:
+        static const unsigned int KEYFRAME_INTERVAL = 60;
+        static const std::size_t DEFAULT_BUDGET = 16 * 1024 * 1024;
+
+        explicit Rewind(std::size_t budget = DEFAULT_BUDGET);
+
+        // Records the state at the end of a frame
+        void push(const Chip8& chip8);
+
+        // Drops the newest frame and restores the one before it; false once
+        // the history is down to a single frame
+        bool stepBack(Chip8& chip8);
+
+        void clear();
+        std::size_t getFrameCount() const;
+        std::size_t getByteCount() const;
+
+    private:
+        struct Frame {
+            unsigned int keyframeDistance;  // Frames back to the keyframe, 0 for a keyframe itself
+            std::vector<uint8_t> data;      // Whole snapshot for a keyframe, encoded delta otherwise
+        };
+
+        std::deque<Frame> frames;
+        std::size_t budget;
+        std::size_t byteCount;
+        std::vector<uint8_t> state;         // Scratch snapshot, reused every frame and sized by the first push
+
+        static void encodeDelta(const uint8_t* state, const uint8_t* keyframe, std::size_t size, std::vector<uint8_t>& out);
+        static void decodeDelta(const std::vector<uint8_t>& delta, const uint8_t* keyframe, std::size_t size, uint8_t* state);
+};
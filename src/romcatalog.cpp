@@ -0,0 +1,80 @@
+#include "romcatalog.hpp"
+#include <filesystem>
+#include <system_error>
+
+RomCatalog::RomCatalog(std::size_t memorySize, const QuirkDatabase& quirks, QuirkProfile fallback)
+    : memorySize(memorySize), quirks(quirks), fallback(fallback), rejectedCount(0) {
+}
+
+const RomCatalog::Entry* RomCatalog::add(const std::string& filename, RomImage::Status* status) {
+    const Entry* known = findPath(filename);
+
+    if (known) {
+        if (status) {
+            *status = RomImage::Status::Ok;
+        }
+
+        return known;
+    }
+
+    std::shared_ptr<const RomImage> image = RomImage::open(filename.c_str(), memorySize, status);
+
+    if (!image) {
+        return nullptr;
+    }
+
+    // Another file with the same contents keeps its image, and this one is dropped
+    auto inserted = entries.emplace(image->getHash(), Entry());
+    Entry& entry = inserted.first->second;
+
+    if (inserted.second) {
+        entry.image = image;
+        entry.path = filename;
+        entry.profile = fallback;
+        entry.listed = quirks.lookup(image->getHash(), entry.profile, &entry.title);
+    }
+
+    paths[filename] = image->getHash();
+    return &entry;
+}
+
+bool RomCatalog::scan(const char* directory) {
+    std::error_code error;
+    std::filesystem::directory_iterator files(directory, error);
+
+    if (error) {
+        return false;
+    }
+
+    for (const std::filesystem::directory_entry& file : files) {
+        if (!file.is_regular_file(error)) {
+            continue;
+        }
+
+        if (!add(file.path().string())) {
+            rejectedCount++;
+        }
+    }
+
+    return true;
+}
+
+const RomCatalog::Entry* RomCatalog::find(uint64_t hash) const {
+    auto entry = entries.find(hash);
+
+    return entry == entries.end() ? nullptr : &entry->second;
+}
+
+const RomCatalog::Entry* RomCatalog::findPath(const std::string& filename) const {
+    auto path = paths.find(filename);
+
+    return path == paths.end() ? nullptr : find(path->second);
+}
+
+std::size_t RomCatalog::size() const {
+    return entries.size();
+}
+
+std::size_t RomCatalog::getRejectedCount() const {
+    return rejectedCount;
+}
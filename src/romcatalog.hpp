@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "quirks.hpp"
+#include "romimage.hpp"
+
+// ROM files indexed by the hash of their contents. Each file is read and
+// validated once, and every machine loading it afterwards shares the same
+// read-only image, however many files or jobs name the same contents. Entries
+// carry the quirk profile and title the QuirkDatabase lists for the ROM.
+//
+// Adding is not thread safe. Once filled, a catalog can be read from any
+// number of threads.
+class RomCatalog {
+    public:
+        struct Entry {
+            std::shared_ptr<const RomImage> image;
+            std::string path;           // First file found with these contents
+            std::string title;          // From the database, or empty
+            QuirkProfile profile;       // From the database, or the catalog's fallback
+            bool listed;                // Whether the database lists the ROM
+        };
+
+        // Images are validated for a core with memorySize bytes of memory.
+        // ROMs the database doesn't list get fallback.
+        RomCatalog(std::size_t memorySize, const QuirkDatabase& quirks, QuirkProfile fallback = QuirkProfile::Default);
+
+        // Adds a file, or finds it if the path or its contents are already
+        // catalogued. Returns null when it can't be added, with the reason in
+        // status if given.
+        const Entry* add(const std::string& filename, RomImage::Status* status = nullptr);
+
+        // Adds every regular file in directory, not its subdirectories.
+        // Files that are unreadable or too large are counted and skipped.
+        // False if the directory can't be read.
+        bool scan(const char* directory);
+
+        const Entry* find(uint64_t hash) const;
+        const Entry* findPath(const std::string& filename) const;
+
+        std::size_t size() const;                   // Distinct ROM contents
+        std::size_t getRejectedCount() const;       // Files scan() skipped
+
+    private:
+        std::size_t memorySize;
+        const QuirkDatabase& quirks;
+        QuirkProfile fallback;
+        std::unordered_map<uint64_t, Entry> entries;
+        std::unordered_map<std::string, uint64_t> paths;
+        std::size_t rejectedCount;
+};
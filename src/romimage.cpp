@@ -0,0 +1,101 @@
+#include "romimage.hpp"
+#include "quirks.hpp"
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define CHIP8_ROM_MMAP 1
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #define CHIP8_ROM_MMAP 0
+#endif
+
+RomImage::RomImage() {
+    hash = 0;
+}
+
+std::shared_ptr<const RomImage> RomImage::open(const char* filename, std::size_t memorySize, Status* status) {
+    std::shared_ptr<RomImage> image(new RomImage());
+    Status result = Status::Ok;
+
+#if CHIP8_ROM_MMAP
+    int fd = ::open(filename, O_RDONLY);
+    struct stat info;
+
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        result = Status::Unreadable;
+    } else if (static_cast<std::size_t>(info.st_size) > maxSize(memorySize)) {
+        result = Status::TooLarge;
+    } else if (info.st_size > 0) {
+        // Pages of a mapping that were never written still show later changes
+        // to the file, and truncating it raises SIGBUS, so the bytes are copied
+        // out and the mapping dropped straight away
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapped == MAP_FAILED) {
+            result = Status::Unreadable;
+        } else {
+            const uint8_t* first = static_cast<const uint8_t*>(mapped);
+            image->bytes.assign(first, first + info.st_size);
+            munmap(mapped, info.st_size);
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+#else
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+
+    if (!file.is_open()) {
+        result = Status::Unreadable;
+    } else if (static_cast<std::size_t>(file.tellg()) > maxSize(memorySize)) {
+        result = Status::TooLarge;
+    } else {
+        file.seekg(0, std::ios::beg);
+        image->bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+#endif
+
+    if (status) {
+        *status = result;
+    }
+
+    if (result != Status::Ok) {
+        return nullptr;
+    }
+
+    image->hash = QuirkDatabase::hash(image->bytes.data(), image->bytes.size());
+    return image;
+}
+
+std::shared_ptr<const RomImage> RomImage::fromBytes(const uint8_t* data, std::size_t size, std::size_t memorySize,
+                                                     Status* status) {
+    if (status) {
+        *status = size > maxSize(memorySize) ? Status::TooLarge : Status::Ok;
+    }
+
+    if (size > maxSize(memorySize)) {
+        return nullptr;
+    }
+
+    std::shared_ptr<RomImage> image(new RomImage());
+    image->bytes.assign(data, data + size);
+    image->hash = QuirkDatabase::hash(image->bytes.data(), image->bytes.size());
+    return image;
+}
+
+const uint8_t* RomImage::data() const {
+    return bytes.data();
+}
+
+std::size_t RomImage::size() const {
+    return bytes.size();
+}
+
+uint64_t RomImage::getHash() const {
+    return hash;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// The bytes of a ROM file, checked once to fit the core it is for. The file
+// is read through a read-only mapping and copied out, so the image keeps the
+// contents it was validated and hashed with even if the file is later edited
+// or truncated. Images are immutable, so any number of machines can load from
+// one shared image; loading copies it into the machine's own memory.
+class RomImage {
+    public:
+        static const unsigned int LOAD_ADDRESS = 0x200;     // Where programs start
+
+        enum class Status {
+            Ok,
+            Unreadable,     // Missing, not a regular file, or failed to map
+            TooLarge        // Doesn't fit between LOAD_ADDRESS and the end of memory
+        };
+
+        // Reads filename and checks that it fits in a core with memorySize
+        // bytes of memory, 0xE00 bytes for the 4 KB core. Returns null on
+        // failure, with the reason in status if given. Without mmap the file
+        // is read with a stream instead.
+        static std::shared_ptr<const RomImage> open(const char* filename, std::size_t memorySize, Status* status = nullptr);
+
+        // Copies size bytes already in memory, checked the same way. Never
+        // Unreadable.
+        static std::shared_ptr<const RomImage> fromBytes(const uint8_t* data, std::size_t size, std::size_t memorySize,
+                                                         Status* status = nullptr);
+
+        // Most a core with memorySize bytes of memory can load
+        static std::size_t maxSize(std::size_t memorySize) {
+            return memorySize - LOAD_ADDRESS;
+        }
+
+        RomImage(const RomImage&) = delete;
+        RomImage& operator=(const RomImage&) = delete;
+
+        const uint8_t* data() const;
+        std::size_t size() const;
+        uint64_t getHash() const;       // FNV-1a of the bytes, as QuirkDatabase keys ROMs
+
+    private:
+        std::vector<uint8_t> bytes;
+        uint64_t hash;
+
+        RomImage();
+};
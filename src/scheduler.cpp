@@ -0,0 +1,65 @@
+#include "scheduler.hpp"
+#include <thread>
+
+Scheduler::Scheduler(Chip8& chip8, unsigned int instructionsPerSecond) : chip8(chip8) {
+    this->instructionsPerSecond = instructionsPerSecond;
+    remainder = 0;
+    frameCount = 0;
+    cycleCount = 0;
+    frameDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / FRAME_RATE));
+    nextFrame = Clock::now() + frameDuration;
+}
+
+unsigned int Scheduler::runFrame(unsigned long long limit) {
+    // Spread rates that are not a multiple of 60 evenly, e.g. 700 IPS runs 11 or 12 per frame
+    unsigned int owed = instructionsPerSecond + remainder;
+    unsigned int instructions = owed / FRAME_RATE;
+    remainder = owed % FRAME_RATE;
+
+    if (instructions > limit) {
+        instructions = limit;
+    }
+
+    chip8.run(instructions);
+    chip8.tickTimers();
+    frameCount++;
+    cycleCount += instructions;
+    return instructions;
+}
+
+void Scheduler::waitForNextFrame() {
+    Clock::time_point now = Clock::now();
+
+    if (now > nextFrame + frameDuration * MAX_LAG_FRAMES) {
+        nextFrame = now;
+    } else {
+        std::this_thread::sleep_until(nextFrame);
+    }
+
+    nextFrame += frameDuration;
+}
+
+void Scheduler::shiftNextFrame(Clock::duration offset) {
+    nextFrame += offset;
+}
+
+Scheduler::Clock::time_point Scheduler::getNextFrame() const {
+    return nextFrame;
+}
+
+void Scheduler::setInstructionsPerSecond(unsigned int instructionsPerSecond) {
+    this->instructionsPerSecond = instructionsPerSecond;
+    remainder = 0;
+}
+
+unsigned int Scheduler::getInstructionsPerSecond() const {
+    return instructionsPerSecond;
+}
+
+unsigned long long Scheduler::getFrameCount() const {
+    return frameCount;
+}
+
+unsigned long long Scheduler::getCycleCount() const {
+    return cycleCount;
+}
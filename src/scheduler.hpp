@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include "chip8.hpp"
+
+// Paces a Chip8 in 60 Hz frames. Each frame runs the instructions due at the
+// configured rate as one batch, ticks the timers once, and then the caller
+// sleeps until the next frame deadline instead of spinning.
+class Scheduler {
+    public:
+        static const unsigned int FRAME_RATE = 60;             // Timer rate, in Hz
+        static const unsigned int DEFAULT_IPS = 700;           // Instructions per second
+        static const unsigned int MAX_LAG_FRAMES = 5;          // Frames to fall behind before resyncing
+
+        Scheduler(Chip8& chip8, unsigned int instructionsPerSecond);
+
+        // Runs one frame worth of instructions, but at most limit, then ticks the timers.
+        // Returns the number of instructions run.
+        unsigned int runFrame(unsigned long long limit = ~0ull);
+
+        // Sleeps until the next frame is due. If the host fell far behind,
+        // the schedule restarts from now rather than running frames back to back.
+        void waitForNextFrame();
+
+        // Moves the next frame deadline, e.g. to line frames up with the display
+        void shiftNextFrame(std::chrono::steady_clock::duration offset);
+        std::chrono::steady_clock::time_point getNextFrame() const;
+
+        void setInstructionsPerSecond(unsigned int instructionsPerSecond);
+        unsigned int getInstructionsPerSecond() const;
+        unsigned long long getFrameCount() const;
+        unsigned long long getCycleCount() const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        Chip8& chip8;
+        unsigned int instructionsPerSecond;
+        unsigned int remainder;                 // Instructions owed from earlier frames, in 1/60ths
+        unsigned long long frameCount;
+        unsigned long long cycleCount;
+        Clock::time_point nextFrame;
+        Clock::duration frameDuration;
+};
@@ -0,0 +1,81 @@
+#include "sound.hpp"
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // Half the steps on, half off: one period of a square wave
+    const uint8_t SQUARE_PATTERN[SoundChannel::PATTERN_BYTES] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+}
+
+SoundChannel::SoundChannel(unsigned int sampleRate)
+    : gateWord(0), gateSet(false), gateOpen(false), patternSet(), patternPublished(false), phase(0), step(0), sampleRate(sampleRate),
+      gateLatency(std::chrono::microseconds(250), 400) {
+    loadPattern(SQUARE_PATTERN, static_cast<double>(TONE_FREQUENCY) * PATTERN_STEPS);
+}
+
+void SoundChannel::setGate(bool open) {
+    if (open == gateSet) {
+        return;
+    }
+
+    gateSet = open;
+    uint64_t time = Clock::now().time_since_epoch().count();
+    gateWord.store((time << 1) | open, std::memory_order_release);
+}
+
+void SoundChannel::setPattern(const uint8_t* pattern, uint8_t pitch) {
+    if (patternPublished && pitch == patternSet.pitch && std::memcmp(pattern, patternSet.bytes, PATTERN_BYTES) == 0) {
+        return;
+    }
+
+    std::memcpy(patternSet.bytes, pattern, PATTERN_BYTES);
+    patternSet.pitch = pitch;
+    patternPublished = true;
+    patterns.writeBuffer() = patternSet;
+    patterns.publish();
+}
+
+void SoundChannel::render(float* samples, std::size_t count) {
+    uint64_t word = gateWord.load(std::memory_order_acquire);
+
+    // XO-CHIP pitch doubles every 48 steps up from 4000 Hz at 64
+    if (patterns.update()) {
+        const Pattern& pattern = patterns.readBuffer();
+        loadPattern(pattern.bytes, PATTERN_RATE * std::pow(2.0, (pattern.pitch - 64) / 48.0));
+    }
+    bool open = word & 1;
+
+    if (open != gateOpen) {
+        Clock::time_point changed(Clock::duration(static_cast<Clock::rep>(word >> 1)));
+        gateLatency.add(Clock::now() - changed);
+        gateOpen = open;
+    }
+
+    if (!gateOpen) {
+        std::fill(samples, samples + count, 0.0f);
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        samples[i] = wave[(phase >> 16) % PATTERN_STEPS];
+        phase += step;
+    }
+
+    // Keep the phase inside the pattern so it never wraps mid-period
+    phase %= PATTERN_STEPS << 16;
+}
+
+const Histogram& SoundChannel::getGateLatency() const {
+    return gateLatency;
+}
+
+void SoundChannel::loadPattern(const uint8_t* pattern, double stepsPerSecond) {
+    for (unsigned int i = 0; i < PATTERN_STEPS; ++i) {
+        wave[i] = (pattern[i / 8] >> (7 - i % 8)) & 1 ? VOLUME : -VOLUME;
+    }
+
+    step = static_cast<uint32_t>(stepsPerSecond / sampleRate * 65536.0);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "histogram.hpp"
+#include "triplebuffer.hpp"
+
+// Turns the sound timer into samples. The emulation thread sets the gate
+// once per frame, and the audio callback renders from a precomputed
+// waveform while the gate is open. The gate travels in a single atomic
+// word together with the time it changed, so neither side ever locks or
+// waits. The callback measures how long each change took to reach it.
+//
+// The waveform is a 16-byte, 128-step 1-bit pattern played at a given
+// rate, which is how XO-CHIP describes its sound. Plain CHIP-8 uses a
+// square wave. An XO-CHIP pattern and pitch reach the callback through a
+// triple buffer, again without a lock.
+class SoundChannel {
+    public:
+        static const unsigned int PATTERN_BYTES = 16;
+        static const unsigned int PATTERN_STEPS = PATTERN_BYTES * 8;
+        static const unsigned int TONE_FREQUENCY = 440;     // Of the CHIP-8 square wave, in Hz
+        static const unsigned int PATTERN_RATE = 4000;      // XO-CHIP steps per second at pitch 64
+        static constexpr float VOLUME = 0.2f;
+
+        explicit SoundChannel(unsigned int sampleRate);
+
+        // Emulation thread
+        void setGate(bool open);
+
+        // Emulation thread: plays an XO-CHIP pattern at an FX3A pitch from
+        // now on. Cheap to call every frame, it only publishes changes.
+        void setPattern(const uint8_t* pattern, uint8_t pitch);
+
+        // Audio thread: fills count mono samples
+        void render(float* samples, std::size_t count);
+
+        // From each gate change to the start of the callback that played it.
+        // Only read once the audio device is closed.
+        const Histogram& getGateLatency() const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Pattern {
+            uint8_t bytes[PATTERN_BYTES];
+            uint8_t pitch;
+        };
+
+        // Steady clock ticks of the last change, shifted up a bit, with the gate in bit 0
+        std::atomic<uint64_t> gateWord;
+        bool gateSet;                       // Emulation thread's copy of the gate
+        bool gateOpen;                      // Audio thread's copy of the gate
+        TripleBuffer<Pattern> patterns;
+        Pattern patternSet;                 // Emulation thread's copy of the last pattern published
+        bool patternPublished;
+
+        float wave[PATTERN_STEPS];          // The pattern expanded to samples
+        uint32_t phase;                     // Position in wave, 16.16 fixed point
+        uint32_t step;                      // Pattern steps per output sample, 16.16 fixed point
+        unsigned int sampleRate;
+        Histogram gateLatency;
+
+        void loadPattern(const uint8_t* pattern, double stepsPerSecond);
+};
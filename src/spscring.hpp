@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free ring buffer for one producer thread and one consumer thread.
+// Neither side ever waits: a push onto a full ring fails and the caller
+// decides what to drop. The consumer reads contiguous spans in place, so
+// they can be handed straight to fwrite.
+template <class T>
+class SpscRing {
+    public:
+        // Capacity is rounded up to a power of two
+        explicit SpscRing(std::size_t capacity) : head(0), cachedTail(0), tail(0) {
+            std::size_t size = 1;
+
+            while (size < capacity) {
+                size <<= 1;
+            }
+
+            buffer.resize(size);
+            mask = size - 1;
+        }
+
+        // Producer side
+        bool tryPush(const T& item) {
+            std::size_t position = head.load(std::memory_order_relaxed);
+
+            // The consumer's position is only reloaded when the ring looks full
+            if (position - cachedTail > mask) {
+                cachedTail = tail.load(std::memory_order_acquire);
+
+                if (position - cachedTail > mask) {
+                    return false;
+                }
+            }
+
+            buffer[position & mask] = item;
+            head.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side: the longest run of items readable without wrapping
+        std::size_t peek(const T*& first) const {
+            std::size_t position = tail.load(std::memory_order_relaxed);
+            std::size_t available = head.load(std::memory_order_acquire) - position;
+            std::size_t untilWrap = buffer.size() - (position & mask);
+
+            first = &buffer[position & mask];
+            return available < untilWrap ? available : untilWrap;
+        }
+
+        // Consumer side: releases items returned by peek()
+        void consume(std::size_t count) {
+            tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        std::size_t capacity() const {
+            return buffer.size();
+        }
+
+    private:
+        // Producer and consumer state on separate cache lines
+        alignas(64) std::atomic<std::size_t> head;
+        std::size_t cachedTail;
+        alignas(64) std::atomic<std::size_t> tail;
+        alignas(64) std::vector<T> buffer;
+        std::size_t mask;
+};
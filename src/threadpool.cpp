@@ -0,0 +1,141 @@
+#include "threadpool.hpp"
+#include <algorithm>
+
+namespace {
+    // Index of the pool worker running on this thread, or -1 outside any pool
+    thread_local int workerIndex = -1;
+    thread_local const ThreadPool* workerPool = nullptr;
+}
+
+ThreadPool::ThreadPool(unsigned int threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    nextQueue = 0;
+    queued = 0;
+    unfinished = 0;
+    stopping = false;
+
+    for (unsigned int i = 0; i < threads; ++i) {
+        queues.emplace_back(new Queue);
+    }
+
+    for (unsigned int i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+
+    wakeWorkers.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    unsigned int index;
+
+    // Counted before the task is visible, so a worker can never take it first and underflow
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued++;
+        unfinished++;
+
+        if (workerPool == this) {
+            index = workerIndex;
+        } else {
+            index = nextQueue;
+            nextQueue = (nextQueue + 1) % queues.size();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+
+    wakeWorkers.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    allDone.wait(lock, [this] { return unfinished == 0; });
+}
+
+unsigned int ThreadPool::size() const {
+    return workers.size();
+}
+
+bool ThreadPool::take(unsigned int index, std::function<void()>& task) {
+    // Own deque first, newest task, while it is still warm in cache
+    {
+        Queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Then the oldest task of another worker
+    for (unsigned int i = 1; i < queues.size(); ++i) {
+        Queue& victim = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::workerLoop(unsigned int index) {
+    workerIndex = index;
+    workerPool = this;
+
+    while (true) {
+        std::function<void()> task;
+
+        if (take(index, task)) {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                queued--;
+            }
+
+            task();
+
+            bool finished;
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                finished = --unfinished == 0;
+            }
+
+            if (finished) {
+                allDone.notify_all();
+            }
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeWorkers.wait(lock, [this] { return queued > 0 || stopping; });
+
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
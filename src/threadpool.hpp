@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool where every worker owns a task deque. Workers take from the
+// back of their own deque and, when it runs dry, steal from the front of the
+// others, so uneven jobs spread out without a single shared queue.
+class ThreadPool {
+    public:
+        // Sized to the core count when threads is 0
+        explicit ThreadPool(unsigned int threads = 0);
+
+        // Finishes every submitted task before returning
+        ~ThreadPool();
+
+        // Queues on the calling worker's own deque, or round-robin from outside the pool
+        void submit(std::function<void()> task);
+
+        // Blocks until every submitted task has finished
+        void wait();
+
+        unsigned int size() const;
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+        unsigned int nextQueue;
+
+        std::mutex sleepMutex;
+        std::condition_variable wakeWorkers;
+        std::condition_variable allDone;
+        unsigned long long queued;              // Tasks sitting in a deque, guarded by sleepMutex
+        unsigned long long unfinished;          // Tasks submitted but not yet finished, guarded by sleepMutex
+        bool stopping;
+
+        void workerLoop(unsigned int index);
+        bool take(unsigned int index, std::function<void()>& task);
+};
@@ -0,0 +1,104 @@
+#include "chip8.hpp"
+#include "tracer.hpp"
+#include <cstdlib>
+#include <cstring>
+
+// Decodes a trace written by Tracer into one line per instruction, or with
+// --summary just counts the records and the gaps left by dropped ones.
+int main(int argc, char **argv) {
+    bool summary = false;
+    const char* filename = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--summary") == 0) {
+            summary = true;
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (!filename) {
+        std::cout << "Usage: " << argv[0] << " [--summary] <trace file>\n";
+        std::exit(0);
+    }
+
+    std::FILE* file = std::fopen(filename, "rb");
+    char magic[4];
+    uint16_t header[2];
+    uint64_t counts[2];             // Records issued and dropped, both zero if the trace wasn't closed
+
+    if (!file) {
+        std::cout << "Could not open trace: " << filename << '\n';
+        std::exit(1);
+    }
+
+    if (std::fread(magic, 1, 4, file) != 4 || std::memcmp(magic, "C8TR", 4) != 0
+            || std::fread(header, sizeof(header), 1, file) != 1
+            || header[0] != Tracer::VERSION || header[1] != sizeof(TraceRecord)
+            || std::fread(counts, sizeof(counts), 1, file) != 1) {
+        std::cout << "Not a trace of this version: " << filename << '\n';
+        std::exit(1);
+    }
+
+    std::vector<TraceRecord> records(4096);
+    unsigned long long count = 0;
+    unsigned long long gaps = 0;
+    unsigned long long missing = 0;
+    unsigned long long nextCycle = 0;
+    std::size_t read;
+
+    while ((read = std::fread(records.data(), sizeof(TraceRecord), records.size(), file)) > 0) {
+        for (std::size_t i = 0; i < read; ++i) {
+            const TraceRecord& record = records[i];
+
+            if (record.cycle != nextCycle) {
+                gaps++;
+                missing += record.cycle - nextCycle;
+
+                if (!summary) {
+                    std::cout << "... " << record.cycle - nextCycle << " records dropped\n";
+                }
+            }
+
+            nextCycle = record.cycle + 1;
+            count++;
+
+            if (summary) {
+                continue;
+            }
+
+            std::cout << std::setw(12) << std::setfill(' ') << record.cycle << std::hex << std::setfill('0')
+                      << "  " << std::setw(3) << record.pc << "  " << std::setw(4) << record.opcode
+                      << "  " << std::setw(7) << std::setfill(' ') << std::left
+                      << Chip8::opName(Chip8::decodeTable()[record.opcode].op) << std::right << std::setfill('0');
+
+            if (record.reg == TraceRecord::NO_REGISTER) {
+                std::cout << "        ";
+            } else {
+                std::cout << "  V" << unsigned(record.reg) << '=' << std::setw(2) << unsigned(record.value);
+            }
+
+            std::cout << "  I=" << std::setw(3) << record.indexReg << std::dec << '\n';
+        }
+    }
+
+    std::fclose(file);
+
+    // Drops after the last record written leave no gap, only a shortfall against the total
+    if (nextCycle < counts[0]) {
+        gaps++;
+        missing += counts[0] - nextCycle;
+
+        if (!summary) {
+            std::cout << "... " << counts[0] - nextCycle << " records dropped\n";
+        }
+    }
+
+    std::cout << "Records:  " << count << '\n';
+    std::cout << "Dropped:  " << missing << " in " << gaps << " gaps\n";
+
+    if (counts[0] == 0 && count > 0) {
+        std::cout << "Trace was not closed, so drops at the end can't be counted\n";
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "tracer.hpp"
+#include <chrono>
+
+namespace {
+    const char MAGIC[4] = { 'C', '8', 'T', 'R' };
+}
+
+Tracer::Tracer() : ring(RING_SIZE), file(nullptr), running(false), cycle(0), dropped(0) {
+}
+
+Tracer::~Tracer() {
+    close();
+}
+
+bool Tracer::open(const char* filename) {
+    close();
+    file = std::fopen(filename, "wb");
+
+    if (!file) {
+        return false;
+    }
+
+    uint16_t header[2] = { VERSION, sizeof(TraceRecord) };
+    uint64_t counts[2] = { 0, 0 };      // Filled in by close()
+    std::fwrite(MAGIC, 1, sizeof(MAGIC), file);
+    std::fwrite(header, sizeof(header), 1, file);
+    std::fwrite(counts, sizeof(counts), 1, file);
+
+    cycle = 0;
+    dropped = 0;
+    running = true;
+    writer = std::thread(&Tracer::drain, this);
+    return true;
+}
+
+void Tracer::close() {
+    if (!file) {
+        return;
+    }
+
+    running = false;
+    writer.join();
+
+    uint64_t counts[2] = { cycle, dropped };
+    std::fseek(file, sizeof(MAGIC) + 2 * sizeof(uint16_t), SEEK_SET);
+    std::fwrite(counts, sizeof(counts), 1, file);
+    std::fclose(file);
+    file = nullptr;
+}
+
+unsigned long long Tracer::getRecordCount() const {
+    return cycle - dropped;
+}
+
+unsigned long long Tracer::getDroppedCount() const {
+    return dropped;
+}
+
+// Writer thread. Sleeps briefly when the ring is empty instead of having the
+// emulation thread signal it, and empties the ring before exiting.
+void Tracer::drain() {
+    while (true) {
+        bool stopping = !running;
+        const TraceRecord* first;
+        std::size_t count = ring.peek(first);
+
+        if (count) {
+            std::fwrite(first, sizeof(TraceRecord), count, file);
+            ring.consume(count);
+        } else if (stopping) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+}
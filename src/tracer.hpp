@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include "spscring.hpp"
+
+// One executed instruction. Register NO_REGISTER means the instruction wrote
+// no register; FX65 reports the last register it loaded.
+struct TraceRecord {
+    static const uint8_t NO_REGISTER = 0xFF;
+
+    uint64_t cycle;             // Instructions traced before this one, dropped ones included
+    uint16_t pc;                // Address the instruction was fetched from
+    uint16_t opcode;
+    uint16_t indexReg;          // I after the instruction
+    uint8_t reg;
+    uint8_t value;              // The register's value after the instruction
+};
+
+static_assert(sizeof(TraceRecord) == 16, "Trace records are written to disk as they are");
+
+// Streams TraceRecords to a file. The emulation thread pushes into a
+// lock-free ring, and a writer thread drains it to disk in large writes.
+// When the writer falls behind, records are dropped and counted rather than
+// blocking the emulation. Dropped records show up as gaps in the cycle
+// numbers.
+//
+// The file is a "C8TR" magic, a 16-bit version, a 16-bit record size, and the
+// 64-bit counts of records issued and dropped, then the records, all in host
+// byte order. The counts are filled in by close(), so a file that was never
+// closed has both zero. With them, a reader can see drops after the last
+// record written.
+class Tracer {
+    public:
+        static const uint16_t VERSION = 2;
+        static const std::size_t RING_SIZE = 1 << 20;      // Records, 16 MB
+
+        Tracer();
+        ~Tracer();
+
+        bool open(const char* filename);
+        void close();                   // Writes out everything still queued
+
+        void record(uint16_t pc, uint16_t opcode, uint16_t indexReg, uint8_t reg, uint8_t value) {
+            TraceRecord entry = { cycle++, pc, opcode, indexReg, reg, value };
+
+            if (!ring.tryPush(entry)) {
+                dropped++;
+            }
+        }
+
+        unsigned long long getRecordCount() const;
+        unsigned long long getDroppedCount() const;
+
+    private:
+        SpscRing<TraceRecord> ring;
+        std::FILE* file;
+        std::thread writer;
+        std::atomic<bool> running;
+        unsigned long long cycle;
+        unsigned long long dropped;
+
+        void drain();
+};
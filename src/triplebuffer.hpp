@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer for one writer thread and one reader thread. The
+// writer fills its back buffer and publishes it, and the reader picks up the
+// newest published buffer. Neither side ever waits: a buffer the reader
+// didn't get to in time is simply overwritten by the next one.
+template <class T>
+class TripleBuffer {
+    public:
+        TripleBuffer() : middle(1), back(0), front(2) {
+        }
+
+        // Writer side
+        T& writeBuffer() {
+            return buffers[back];
+        }
+
+        // Writer side: swaps the back buffer with the middle one and flags it fresh
+        void publish() {
+            back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // Reader side: moves to the newest buffer if one was published since
+        // the last call. Returns false, keeping the current one, otherwise.
+        bool update() {
+            if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+                return false;
+            }
+
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+
+        // Reader side
+        const T& readBuffer() const {
+            return buffers[front];
+        }
+
+    private:
+        static const uint8_t INDEX = 3;
+        static const uint8_t FRESH = 4;
+
+        T buffers[3];
+        alignas(64) std::atomic<uint8_t> middle;    // Buffer index, with FRESH set until the reader takes it
+        alignas(64) uint8_t back;                   // Writer only
+        alignas(64) uint8_t front;                  // Reader only
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// xorshift64* generator for CXNN. Small enough to copy into a snapshot as one
+// word, and the same seed gives the same bytes on every platform.
+struct Xorshift {
+    uint64_t state;
+
+    void seed(uint64_t value) {
+        // One splitmix64 round, so small or similar seeds still start far apart and never at 0
+        uint64_t z = value + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        state = (z ^ (z >> 31)) | 1;
+    }
+
+    uint8_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (state * 0x2545F4914F6CDD1Dull) >> 56;
+    }
+};